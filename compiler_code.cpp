@@ -12,16 +12,226 @@
 
 
 #include <iostream>
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>       // For the instrumentation timers
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>       // For the portable file reader
+#include <cstring>      // For memchr
+#include <functional>
+#include <list>
+#include <mutex>
 #include <string>
+#include <string_view>    // For zero-copy token values
+#include <thread>
 #include <vector>
-#include <queue>        // For level-order traversal
 #include <memory>       // For smart pointers
 #include <unordered_map>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>  // SSE2/AVX2 scanning kernels
+#define LEXER_HAVE_SSE2 1
+#if defined(__x86_64__) || defined(__i386__)
+#define LEXER_HAVE_AVX2 1   // Compiled with a target attribute, enabled by runtime dispatch; tails use SSE2
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>   // NEON scanning kernels
+#define LEXER_HAVE_NEON 1
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>      // Memory-mapped input files
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define INPUT_HAVE_MMAP 1
+#endif
+#ifdef COMPILER_BENCHMARK
+#include <benchmark/benchmark.h>    // Benchmark build: -DCOMPILER_BENCHMARK -lbenchmark -pthread
+#endif
+#ifdef COMPILER_FUZZER
+#include <cctype>       // Character classes of the reference Lexer
+#include <cstdlib>
+#include <new>          // Counting global operator new
+#endif
 
-std::vector<std::string> lexicalErrors;     ///< List of lexical errors (Defining it globally because it has multiple uses)
 
+// Buffered output
+/**
+ * @class OutputSink
+ * @brief Destination for printed output, formatted into a fixed buffer and drained in blocks.
+ *
+ * Nothing is flushed per line: output reaches the destination when the buffer fills, on
+ * flush(), or when the sink is destroyed. Writing never allocates.
+ */
+class OutputSink {
+public:
+    OutputSink() = default;
+    virtual ~OutputSink() = default;
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    OutputSink& operator<<(std::string_view text) { write(text); return *this; }
+    OutputSink& operator<<(char c) { put(c); return *this; }
+
+    /**
+     * @brief Appends bytes; blocks larger than the buffer bypass it.
+     */
+    void write(std::string_view text) {
+        if (text.empty()) return;           // An empty view may have a null data()
+        if (text.size() > static_cast<size_t>(BUFFER_SIZE - used)) {
+            flush();
+            if (text.size() >= BUFFER_SIZE) {
+                drain(text.data(), text.size());
+                return;
+            }
+        }
+        std::memcpy(buffer + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    /**
+     * @brief Appends one byte.
+     */
+    void put(char c) {
+        if (used == BUFFER_SIZE) flush();
+        buffer[used++] = c;
+    }
+
+    /**
+     * @brief Appends an unsigned integer in decimal.
+     */
+    void writeNumber(uint64_t value) {
+        char digits[20];
+        size_t first = sizeof(digits);
+        do {
+            digits[--first] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        write(std::string_view(digits + first, sizeof(digits) - first));
+    }
+
+    /**
+     * @brief Hands the buffered bytes to the destination.
+     */
+    void flush() {
+        if (used == 0) return;
+        drain(buffer, used);
+        used = 0;
+    }
+
+protected:
+    /**
+     * @brief Delivers bytes to the destination. Derived destructors must call flush().
+     */
+    virtual void drain(const char* data, size_t length) = 0;
+
+private:
+    static constexpr size_t BUFFER_SIZE = 8192;
+
+    char buffer[BUFFER_SIZE];
+    size_t used = 0;                ///< Bytes buffered and not yet drained
+};
+
+/**
+ * @class FdSink
+ * @brief Writes to a file descriptor (stdout by default).
+ */
+class FdSink : public OutputSink {
+public:
+    explicit FdSink(int fd = 1) : fd(fd) {}
+    ~FdSink() override { flush(); }
+
+    /**
+     * @brief Whether a write to the descriptor has failed.
+     */
+    bool failed() const { return writeFailed; }
+
+protected:
+    void drain(const char* data, size_t length) override {
+#ifdef INPUT_HAVE_MMAP
+        while (length > 0 && !writeFailed) {
+            const ssize_t written = ::write(fd, data, length);
+            if (written < 0) {
+                if (errno != EINTR) writeFailed = true;
+                continue;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+#else
+        std::FILE* file = fd == 2 ? stderr : stdout;
+        if (std::fwrite(data, 1, length, file) != length || std::fflush(file) != 0) writeFailed = true;
+#endif
+    }
+
+private:
+    int fd;
+    bool writeFailed = false;
+};
+
+/**
+ * @class StringSink
+ * @brief Appends to a std::string; call flush() before reading it.
+ */
+class StringSink : public OutputSink {
+public:
+    explicit StringSink(std::string& out) : out(out) {}
+    ~StringSink() override { flush(); }
+
+protected:
+    void drain(const char* data, size_t length) override { out.append(data, length); }
+
+private:
+    std::string& out;
+};
+
+/**
+ * @class MemorySink
+ * @brief Writes into a caller-provided block of memory, dropping whatever does not fit.
+ */
+class MemorySink : public OutputSink {
+public:
+    MemorySink(char* data, size_t capacity) : data(data), capacity(capacity) {}
+    ~MemorySink() override { flush(); }
+
+    size_t size() const { return length; }              ///< Bytes stored so far (after flush())
+    bool truncated() const { return overflowed; }       ///< Whether output was dropped
+
+protected:
+    void drain(const char* bytes, size_t count) override {
+        const size_t room = std::min(count, capacity - length);
+        std::memcpy(data + length, bytes, room);
+        length += room;
+        overflowed = overflowed || room < count;
+    }
+
+private:
+    char* data;
+    size_t capacity;
+    size_t length = 0;
+    bool overflowed = false;
+};
+
+/**
+ * @brief The buffered sink for standard output used by the print functions by default.
+ *
+ * It is flushed at exit; flush it before writing to std::cout directly.
+ */
+inline FdSink& standardOutput() {
+    static FdSink sink(1);
+    return sink;
+}
+
+
+
+constexpr uint32_t NO_SYMBOL = 0xFFFFFFFFu;  ///< Symbol id of tokens that are not in the symbol table
+constexpr uint32_t NO_TOKEN = 0xFFFFFFFFu;   ///< Token index of AST nodes that do not stand for a token
+constexpr uint32_t NO_NODE = 0xFFFFFFFFu;    ///< Node index meaning "no node" in a FlatAst
 
 
 // Token types enumeration
@@ -36,291 +246,4318 @@ enum TokenType { STARTWORD, WORD, COMMA, HYPHEN, STOP, QUOTATION, INVALID, END }
 /**
  * @struct Token
  * @brief Represents a token with a type and its corresponding string value.
+ *
+ * The value is a view into the buffer the Lexer was constructed over, so tokens are only
+ * valid for as long as that buffer is alive and unmodified.
  */
 struct Token {
     TokenType type;
-    std::string value;
+    std::string_view value;         ///< Slice of the lexer input (without the quotes for quotations)
+    uint32_t symbol = NO_SYMBOL;    ///< Interned symbol id for words in the symbol table
+    size_t offset = 0;              ///< Byte offset of the token in the input (at the opening quote for quotations)
 };
 
 
-// AST Node structure
-/**
- * @struct ASTNode
- * @brief Represents a node in the Abstract Syntax Tree (AST).
- * 
- * Each ASTNode holds a value (e.g., token value or type) and a list of child nodes, forming the tree structure.
+// Opt-in instrumentation
+/*
+ * Built with -DCOMPILER_INSTRUMENT, the compiler times its phases and counts what it does:
+ * tokens by type, split words, hyphen lookaheads, AST nodes and bytes allocated. Without the
+ * flag the COMPILER_COUNT and COMPILER_TIME_PHASE macros expand to nothing and none of this
+ * is compiled. Counters are per thread (no atomic read-modify-write on the hot paths) and are
+ * summed when read, so they can stay enabled under the thread pool.
  */
-struct ASTNode {
-    std::string value;                                      ///< Value of the node (e.g., token or expression)
-    std::vector<std::shared_ptr<ASTNode>> children;         ///< List of child nodes
+#ifdef COMPILER_INSTRUMENT
 
-    // Constructor
-    /**
-     * @brief Constructs an ASTNode with the given value.
-     * @param val The value of the AST node.
-     */
-    ASTNode(const std::string& val) : value(val) {}
+/**
+ * @brief Timed phases. AST building happens inside parsing and is counted, not timed apart.
+ */
+enum InstrumentPhase {
+    PHASE_LEX,                  ///< Lexer loops (tokenizeAll, tokenizePacked, CompilerSession::diagnose)
+    PHASE_PARSE,                ///< Parser::parseSentence and Parser::diagnose
+    PHASE_STREAM,               ///< StreamingValidator::run: lexing and checking in one pass
+    PHASE_PRINT,                ///< printASTLevelOrder
+    PHASE_COUNT
+};
 
-    // Method to add a child node
-    /**
-     * @brief Adds a child node to the current node.
-     * @param child Shared pointer to the child ASTNode.
-     */
-    void addChild(std::shared_ptr<ASTNode> child) {
-        children.push_back(child);
-    }
+/**
+ * @brief Counter slots. The token counters are indexed by TokenType from COUNTER_TOKENS.
+ */
+enum InstrumentCounter {
+    COUNTER_TOKENS,                                 ///< First of the per-TokenType counters
+    COUNTER_SPLIT_WORDS = COUNTER_TOKENS + END + 1, ///< Words cut at the 26-letter limit
+    COUNTER_HYPHEN_LOOKAHEADS,                      ///< Consecutive hyphens checked against the commas ahead
+    COUNTER_HYPHEN_SCANNED_TOKENS,                  ///< Tokens read by those comma scans
+    COUNTER_AST_NODES,                              ///< Nodes added to ASTNode or FlatAst trees
+    COUNTER_ALLOCATED_BYTES,                        ///< Bytes allocated by AST arenas, symbol tables and token buffers
+    COUNTER_PHASE_CALLS,                            ///< Calls of each phase, indexed by InstrumentPhase
+    COUNTER_PHASE_NANOSECONDS = COUNTER_PHASE_CALLS + PHASE_COUNT,  ///< Time in each phase
+    COUNTER_COUNT = COUNTER_PHASE_NANOSECONDS + PHASE_COUNT
 };
 
+/**
+ * @struct InstrumentSnapshot
+ * @brief Totals of every counter, summed over all threads.
+ */
+struct InstrumentSnapshot {
+    uint64_t values[COUNTER_COUNT] = {};
 
+    uint64_t tokens(TokenType type) const { return values[COUNTER_TOKENS + type]; }
+    uint64_t phaseCalls(InstrumentPhase phase) const { return values[COUNTER_PHASE_CALLS + phase]; }
+    uint64_t phaseNanoseconds(InstrumentPhase phase) const { return values[COUNTER_PHASE_NANOSECONDS + phase]; }
+};
 
-// Lexer class to tokenize input strings
 /**
- * @class Lexer
- * @brief The Lexer class tokenizes input strings based on lexical specifications.
+ * @class Instrumentation
+ * @brief Registry of the per-thread counter blocks.
  *
- * It processes input character by character and generates tokens such as words, punctuation, and quotations.
- * Errors are raised for invalid tokens, and a symbol table is built for valid words.
+ * Each thread gets a block on its first count. Only that thread writes it, with relaxed loads
+ * and stores, and readers sum all blocks. Blocks outlive their threads so totals are never
+ * lost. reset() does not touch the blocks: it records a baseline that snapshot() subtracts.
  */
-class Lexer {
+class Instrumentation {
 public:
-    // Constructor
+    static Instrumentation& instance() {
+        static Instrumentation registry;
+        return registry;
+    }
+
     /**
-     * @brief Constructs a Lexer with the provided input string.
-     * @param input The input string to tokenize.
+     * @brief Adds to a counter of the calling thread.
      */
-    Lexer(const std::string &input) : input(input), pos(0) {}
+    static void count(unsigned counter, uint64_t amount) {
+        std::atomic<uint64_t>& value = local().values[counter];
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
 
-    // Method to get the next token from input
     /**
-     * @brief Retrieves the next token from the input string.
-     * @return Token The next token in the input stream.
-     *
-     * This function skips whitespaces, identifies valid tokens such as words, punctuation, or quotations, 
-     * and splits words longer than 26 characters. Invalid tokens are also handled and returned.
+     * @brief Returns the totals since the last reset().
      */
-    Token nextToken() {
-        // Skip whitespace
-        while (pos < input.length() && std::isspace(input[pos])) {
-            pos++;
-        }
+    InstrumentSnapshot snapshot() {
+        InstrumentSnapshot totals = sum();
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) totals.values[i] -= baseline.values[i];
+        return totals;
+    }
 
-        if (pos >= input.length()) return { END, "" };
+    /**
+     * @brief Starts counting from zero again.
+     */
+    void reset() {
+        const InstrumentSnapshot totals = sum();
+        std::lock_guard<std::mutex> lock(mutex);
+        baseline = totals;
+    }
 
-        char current = input[pos];
+private:
+    struct alignas(64) Block {
+        std::atomic<uint64_t> values[COUNTER_COUNT] = {};
+    };
 
-        // Handle punctuation and stop tokens
-        if (current == ',') {
-            pos++;
-            return { COMMA, "," };
-        }
-        if (current == '-') {
-            pos++;
-            return { HYPHEN, "-" };
-        }
-        if (current == '.') {
-            pos++;
-            return { STOP, "." };
-        }
+    static Block& local() {
+        thread_local Block* block = instance().addBlock();
+        return *block;
+    }
 
-        // Handle quotations
-        if (current == '\'') {
-            pos++;
-            std::string quotedText;
-            while (pos < input.length() && input[pos] != '\'') {
-                quotedText += input[pos++];
-            }
-            if (pos < input.length()) pos++; // Skip closing quote
-            return { QUOTATION, quotedText };
-        }
+    Block* addBlock() {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.push_back(std::make_unique<Block>());
+        return blocks.back().get();
+    }
 
-        // Identify words (valid and split longer words)
-        std::string word;
-        while (pos < input.length() && std::isalpha(input[pos])) {
-            word += input[pos++];
+    InstrumentSnapshot sum() {
+        InstrumentSnapshot totals;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& block : blocks) {
+            for (size_t i = 0; i < COUNTER_COUNT; ++i) totals.values[i] += block->values[i].load(std::memory_order_relaxed);
         }
+        return totals;
+    }
 
-        if (!word.empty()) {
-            if (word.length() > 26) {
-                // Split long words
-                std::string firstPart = word.substr(0, 26);
-                std::string remainingPart = word.substr(26);
-                pos -= remainingPart.length();              // Adjust position to tokenize remaining part later
-                return { WORD, firstPart };
-            }
-            if (word.length() >= 3 && word.length() <= 26) {
-                if (std::isupper(word[0])) {
-                    symbolTable.push_back(word);            // Add to symbol table
-                    return { STARTWORD, word };
-                } else {
-                    symbolTable.push_back(word);            // Add to symbol table
-                    return { WORD, word };
-                }
-            } else {
-                return { INVALID, word };                   // Invalid token if word length is wrong
-            }
-        }
+    std::mutex mutex;                               ///< Guards blocks and baseline
+    std::vector<std::unique_ptr<Block>> blocks;     ///< One block per thread that has counted
+    InstrumentSnapshot baseline;                    ///< Totals at the last reset()
+};
 
-        // If we reach here, it's an invalid token
-        std::string invalidToken;
-        while (pos < input.length() && !std::isspace(input[pos]) && input[pos] != ',' && input[pos] != '-' && input[pos] != '.') {
-            invalidToken += input[pos++];
-        }
-        return { INVALID, invalidToken };
+/**
+ * @class PhaseTimer
+ * @brief Adds the time from construction to destruction to a phase.
+ */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(InstrumentPhase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        Instrumentation::count(COUNTER_PHASE_CALLS + phase, 1);
+        Instrumentation::count(COUNTER_PHASE_NANOSECONDS + phase, static_cast<uint64_t>(elapsed.count()));
     }
 
-    
-    // Display symbol table
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    InstrumentPhase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define COMPILER_COUNT(counter, amount) Instrumentation::count((counter), (amount))
+#define COMPILER_TIME_PHASE(phase) PhaseTimer phaseTimer(phase)
+
+inline const char* instrumentPhaseName(InstrumentPhase phase) {
+    static const char* const NAMES[PHASE_COUNT] = { "lex", "parse", "stream", "print" };
+    return NAMES[phase];
+}
+
+inline const char* instrumentTokenName(TokenType type) {
+    static const char* const NAMES[END + 1] = { "startword", "word", "comma", "hyphen", "stop", "quotation", "invalid", "end" };
+    return NAMES[type];
+}
+
+/**
+ * @brief Writes the totals since the last reset as one JSON object.
+ */
+inline void writeInstrumentJson(OutputSink& out) {
+    const InstrumentSnapshot totals = Instrumentation::instance().snapshot();
+    out << "{\"phases\":{";
+    for (unsigned phase = 0; phase < PHASE_COUNT; ++phase) {
+        if (phase) out << ',';
+        out << '"' << instrumentPhaseName(static_cast<InstrumentPhase>(phase)) << "\":{\"calls\":";
+        out.writeNumber(totals.phaseCalls(static_cast<InstrumentPhase>(phase)));
+        out << ",\"nanoseconds\":";
+        out.writeNumber(totals.phaseNanoseconds(static_cast<InstrumentPhase>(phase)));
+        out << '}';
+    }
+    out << "},\"tokens\":{";
+    for (unsigned type = 0; type <= END; ++type) {
+        if (type) out << ',';
+        out << '"' << instrumentTokenName(static_cast<TokenType>(type)) << "\":";
+        out.writeNumber(totals.tokens(static_cast<TokenType>(type)));
+    }
+    out << "},\"split_words\":";
+    out.writeNumber(totals.values[COUNTER_SPLIT_WORDS]);
+    out << ",\"hyphen_lookaheads\":";
+    out.writeNumber(totals.values[COUNTER_HYPHEN_LOOKAHEADS]);
+    out << ",\"hyphen_scanned_tokens\":";
+    out.writeNumber(totals.values[COUNTER_HYPHEN_SCANNED_TOKENS]);
+    out << ",\"ast_nodes\":";
+    out.writeNumber(totals.values[COUNTER_AST_NODES]);
+    out << ",\"allocated_bytes\":";
+    out.writeNumber(totals.values[COUNTER_ALLOCATED_BYTES]);
+    out << "}\n";
+}
+
+/**
+ * @brief Writes the totals since the last reset in the Prometheus text exposition format.
+ */
+inline void writeInstrumentPrometheus(OutputSink& out) {
+    const InstrumentSnapshot totals = Instrumentation::instance().snapshot();
+    auto counter = [&](const char* name, const char* help, uint64_t value) {
+        out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " counter\n" << name << ' ';
+        out.writeNumber(value);
+        out << '\n';
+    };
+
+    out << "# HELP compiler_phase_calls_total Calls of each compiler phase.\n# TYPE compiler_phase_calls_total counter\n";
+    for (unsigned phase = 0; phase < PHASE_COUNT; ++phase) {
+        out << "compiler_phase_calls_total{phase=\"" << instrumentPhaseName(static_cast<InstrumentPhase>(phase)) << "\"} ";
+        out.writeNumber(totals.phaseCalls(static_cast<InstrumentPhase>(phase)));
+        out << '\n';
+    }
+    out << "# HELP compiler_phase_nanoseconds_total Time spent in each compiler phase.\n# TYPE compiler_phase_nanoseconds_total counter\n";
+    for (unsigned phase = 0; phase < PHASE_COUNT; ++phase) {
+        out << "compiler_phase_nanoseconds_total{phase=\"" << instrumentPhaseName(static_cast<InstrumentPhase>(phase)) << "\"} ";
+        out.writeNumber(totals.phaseNanoseconds(static_cast<InstrumentPhase>(phase)));
+        out << '\n';
+    }
+    out << "# HELP compiler_tokens_total Tokens produced by the lexer.\n# TYPE compiler_tokens_total counter\n";
+    for (unsigned type = 0; type <= END; ++type) {
+        out << "compiler_tokens_total{type=\"" << instrumentTokenName(static_cast<TokenType>(type)) << "\"} ";
+        out.writeNumber(totals.tokens(static_cast<TokenType>(type)));
+        out << '\n';
+    }
+    counter("compiler_split_words_total", "Words cut at the 26-letter limit.", totals.values[COUNTER_SPLIT_WORDS]);
+    counter("compiler_hyphen_lookaheads_total", "Consecutive hyphens checked against the commas ahead.", totals.values[COUNTER_HYPHEN_LOOKAHEADS]);
+    counter("compiler_hyphen_scanned_tokens_total", "Tokens read by hyphen lookahead scans.", totals.values[COUNTER_HYPHEN_SCANNED_TOKENS]);
+    counter("compiler_ast_nodes_total", "AST nodes built.", totals.values[COUNTER_AST_NODES]);
+    counter("compiler_allocated_bytes_total", "Bytes allocated by AST arenas, symbol tables and token buffers.", totals.values[COUNTER_ALLOCATED_BYTES]);
+}
+
+#else
+#define COMPILER_COUNT(counter, amount) ((void)sizeof(amount))
+#define COMPILER_TIME_PHASE(phase) ((void)0)
+#endif
+
+
+// Line and column lookup
+/**
+ * @class LineIndex
+ * @brief Turns byte offsets into line and column numbers.
+ *
+ * The line starts are found with one memchr pass the first time a position is asked for,
+ * so inputs whose diagnostics are never displayed pay nothing. Lookups are binary searches.
+ */
+class LineIndex {
+public:
     /**
-     * @brief Prints the symbol table generated during tokenization.
+     * @struct Position
+     * @brief A 1-based line and a 1-based column counted in bytes.
      */
-    void printSymbolTable() const {
-        std::cout << "\nSymbol Table: \n";
-        for (const auto& symbol : symbolTable) {
-            std::cout << symbol << std::endl;
-        }
+    struct Position {
+        size_t line;
+        size_t column;
+    };
+
+    /**
+     * @brief Constructor.
+     * @param text The text offsets refer to; borrowed.
+     */
+    explicit LineIndex(std::string_view text) : text(text) {}
+
+    /**
+     * @brief Returns the position of a byte offset (offsets past the end map to the end).
+     */
+    Position locate(size_t offset) const {
+        if (!built) build();
+        offset = std::min(offset, text.size());
+        const size_t line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin();
+        return { line, offset - lineStarts[line - 1] + 1 };
     }
 
 private:
-    std::string input;                     ///< Input string to be tokenized
-    size_t pos;                            ///< Current position in the input string
-    std::vector<std::string> symbolTable;  ///< Symbol table to store valid words
+    void build() const {
+        lineStarts.push_back(0);
+        const char* data = text.data();
+        for (const void* newline = std::memchr(data, '\n', text.size()); newline;
+             newline = std::memchr(static_cast<const char*>(newline) + 1, '\n', text.size() - (static_cast<const char*>(newline) + 1 - data))) {
+            lineStarts.push_back(static_cast<const char*>(newline) + 1 - data);
+        }
+        built = true;
+    }
 
+    std::string_view text;
+    mutable std::vector<size_t> lineStarts;     ///< Offset of the first byte of each line
+    mutable bool built = false;
 };
 
 
+// Packed token representation
+/**
+ * @struct PackedToken
+ * @brief A token in 64 bits: type (4), byte length (8), symbol id (20) and input offset (32).
+ *
+ * The value is not stored; it is the byte range [offset, offset + length) of the input. A
+ * length of LONG_LENGTH (quotations of 255 bytes or more) and a symbol of WIDE_SYMBOL (ids
+ * that do not fit in 20 bits) mean that the real value is in a side table of the
+ * PackedTokenStream.
+ */
+struct PackedToken {
+    static constexpr uint32_t LONG_LENGTH = 0xFF;       ///< Length kept in the side table
+    static constexpr uint32_t WIDE_SYMBOL = 0xFFFFE;    ///< Symbol id kept in the side table
+    static constexpr uint32_t NO_PACKED_SYMBOL = 0xFFFFF;
 
+    uint64_t bits;
+
+    TokenType type() const { return static_cast<TokenType>(bits & 0xF); }
+    uint32_t packedLength() const { return static_cast<uint32_t>(bits >> 4) & 0xFF; }
+    uint32_t packedSymbol() const { return static_cast<uint32_t>(bits >> 12) & 0xFFFFF; }
+    uint32_t offset() const { return static_cast<uint32_t>(bits >> 32); }
+
+    static PackedToken pack(TokenType type, uint32_t offset, uint32_t length, uint32_t symbol) {
+        return { static_cast<uint64_t>(type) | static_cast<uint64_t>(length) << 4 | static_cast<uint64_t>(symbol) << 12 | static_cast<uint64_t>(offset) << 32 };
+    }
+};
+
+static_assert(sizeof(PackedToken) == 8, "PackedToken must stay 8 bytes");
 
-// Parser class for parsing the tokens generated
 /**
- * @class Parser
- * @brief Syntactic analyzer that parses a sequence of tokens based on grammer rules specified
- * 
- * The Parser class takes a sequence of tokens generated by the Lexer and checks whether 
- * they conform to the syntactic rules of the language. It builds an Abstract Syntax Tree (AST) 
- * to represent the structure of the input, and handles errors if the input is not valid.
+ * @class PackedTokenStream
+ * @brief Contiguous array of PackedTokens over one input, with side tables for the rare
+ *        values that do not fit.
+ *
+ * The side tables hold (token index, value) pairs in token order and are binary-searched, so
+ * only long quotations and very large vocabularies pay for them. A PackedParser reads the
+ * stream in place: the grammar checks only look at the type bits, and a Token is expanded
+ * only where the Parser needs its text.
  */
-class Parser {
+class PackedTokenStream {
 public:
-    //Constructor
+    static constexpr size_t MAX_INPUT = 0xFFFFFFFFu;   ///< Longest input whose offsets fit in 32 bits
+
     /**
-     * @brief Constructor that initializes the Parser with a sequence of tokens.
-     * @param tokens A vector of tokens produced by the Lexer.
+     * @brief Removes all tokens, keeping the allocated capacity.
      */
-    Parser(const std::vector<Token>& tokens) : tokens(tokens), currentPos(0) {}
+    void clear() {
+        packed.clear();
+        longLengths.clear();
+        wideSymbols.clear();
+    }
+
+    void reserve(size_t count) { packed.reserve(count); }
+    size_t size() const { return packed.size(); }
+    bool empty() const { return packed.empty(); }
+    const PackedToken* data() const { return packed.data(); }
 
     /**
-     * @brief Parses the input tokens to build an AST.
-     * 
-     * The parse() method begins by parsing the first token as a start word, then continues 
-     * parsing subsequent tokens based on the language's syntactic rules (handling words, commas, 
-     * hyphens, and punctuation). If the input is valid, it returns a pointer to the root of the AST.
-     * 
-     * @return std::shared_ptr<ASTNode> The root node of the AST, or nullptr if there are errors.
+     * @brief Sets the input the token values are read from by operator[] and back().
+     */
+    void setInput(std::string_view text) { input = text; }
+
+    /**
+     * @brief Appends a token.
+     * @param token The token.
+     * @param offset Byte offset of the token value in the input (after the quote for quotations).
      */
-    std::shared_ptr<ASTNode> parse() {
-        return parseSentence();
+    void push(const Token& token, uint32_t offset) {
+        const uint32_t index = static_cast<uint32_t>(packed.size());
+        uint32_t length = static_cast<uint32_t>(token.value.size());
+        if (length >= PackedToken::LONG_LENGTH) {
+            longLengths.emplace_back(index, length);
+            length = PackedToken::LONG_LENGTH;
+        }
+        uint32_t symbol = token.symbol;
+        if (symbol == NO_SYMBOL) {
+            symbol = PackedToken::NO_PACKED_SYMBOL;
+        } else if (symbol >= PackedToken::WIDE_SYMBOL) {
+            wideSymbols.emplace_back(index, symbol);
+            symbol = PackedToken::WIDE_SYMBOL;
+        }
+        packed.push_back(PackedToken::pack(token.type, offset, length, symbol));
     }
 
+    TokenType type(size_t index) const { return packed[index].type(); }
+    uint32_t offset(size_t index) const { return packed[index].offset(); }
+
     /**
-     * @brief Checks if any errors were encountered during parsing.
-     * @return bool True if errors exist, false otherwise.
+     * @brief Returns the byte length of a token value.
      */
-    bool hasErrors() const { return !errors.empty(); }
+    uint32_t length(size_t index) const {
+        const uint32_t length = packed[index].packedLength();
+        return length == PackedToken::LONG_LENGTH ? sideValue(longLengths, index) : length;
+    }
 
     /**
-     * @brief Prints any errors encountered during the parsing process.
+     * @brief Returns the symbol id of a token, or NO_SYMBOL.
      */
-    void printErrors() const {
-        for (const auto& error : errors) {
-            std::cout << error << std::endl;
-        }
+    uint32_t symbol(size_t index) const {
+        const uint32_t symbol = packed[index].packedSymbol();
+        if (symbol == PackedToken::NO_PACKED_SYMBOL) return NO_SYMBOL;
+        return symbol == PackedToken::WIDE_SYMBOL ? sideValue(wideSymbols, index) : symbol;
     }
-    
+
     /**
-     * @brief Prints the accepted string formed during parsing (skipping quotations).
+     * @brief Expands a token.
+     * @param index Index of the token.
+     * @param input The input the stream was built from.
      */
-    void printAcceptedString() const {
-        for (size_t i = 0; i < acceptedTokens.size(); ++i) {
-            if (acceptedTokens[i].type != QUOTATION) {
-                std::cout << acceptedTokens[i].value;
-                if (i != acceptedTokens.size() - 1 ) {
-                    std::cout << " ";                   // Add space between tokens 
-                }
-            }
-        }
-        std::cout << std::endl;
+    Token token(size_t index, std::string_view input) const {
+        const TokenType tokenType = type(index);
+        return { tokenType, input.substr(offset(index), length(index)), symbol(index), offset(index) - (tokenType == QUOTATION ? 1u : 0u) };
+    }
+
+    Token operator[](size_t index) const { return token(index, input); }   ///< Expands a token of the input set by setInput()
+    Token back() const { return token(packed.size() - 1, input); }         ///< Expands the last token
+
+    /**
+     * @brief Expands every token, for example to hand them to a Parser.
+     * @param input The input the stream was built from.
+     * @param tokens Receives the tokens (existing contents are replaced).
+     */
+    void unpack(std::string_view input, std::vector<Token>& tokens) const {
+        tokens.clear();
+        tokens.reserve(packed.size());
+        for (size_t index = 0; index < packed.size(); ++index) tokens.push_back(token(index, input));
     }
 
 private:
-    std::vector<Token> tokens;          ///< The input tokens produced by the Lexer.
-    size_t currentPos;                  ///< Current position in the token list.
-    std::vector<std::string> errors;    ///< List of errors encountered during parsing.
-    std::vector<Token> acceptedTokens;  ///< List of accepted tokens that form the valid string.
+    using SideTable = std::vector<std::pair<uint32_t, uint32_t>>;
+
+    static uint32_t sideValue(const SideTable& table, size_t index) {
+        const auto entry = std::lower_bound(table.begin(), table.end(), std::make_pair(static_cast<uint32_t>(index), 0u));
+        return entry->second;
+    }
+
+    std::vector<PackedToken> packed;
+    std::string_view input;         ///< Input the tokens were lexed from
+    SideTable longLengths;          ///< Lengths of LONG_LENGTH tokens
+    SideTable wideSymbols;          ///< Symbol ids of WIDE_SYMBOL tokens
+};
+
+
+
+// AST node kinds enumeration
+/**
+ * @enum NodeKind
+ * @brief Enumerates the kinds of nodes in the Abstract Syntax Tree (AST).
+ */
+enum NodeKind : unsigned char { NODE_SENTENCE, NODE_STARTWORD, NODE_WORD, NODE_COMMA, NODE_HYPHEN, NODE_QUOTATION, NODE_STOP };
+
+
+// AST Node structure
+/**
+ * @struct ASTNode
+ * @brief Represents a node in the Abstract Syntax Tree (AST).
+ * 
+ * Each ASTNode holds its kind and the index of the token it was built from; the text is read
+ * from the token vector when needed. Children form a singly linked list through nextSibling,
+ * so a node needs no allocation of its own besides the node itself.
+ */
+struct ASTNode {
+    NodeKind kind;                          ///< Kind of the node (e.g., Word or Comma)
+    uint32_t tokenIndex;                    ///< Index of the token the node stands for, or NO_TOKEN
+    ASTNode* firstChild = nullptr;          ///< First child node
+    ASTNode* lastChild = nullptr;           ///< Last child node, for appending
+    ASTNode* nextSibling = nullptr;         ///< Next node under the same parent
+
+    // Method to add a child node
+    /**
+     * @brief Appends a child node to the current node.
+     * @param child The child node, allocated from the same arena.
+     */
+    void addChild(ASTNode* child) {
+        if (lastChild) lastChild->nextSibling = child;
+        else firstChild = child;
+        lastChild = child;
+    }
+};
+
+
+// Arena that owns all AST nodes of a parse
+/**
+ * @class AstArena
+ * @brief Bump allocator for ASTNodes.
+ *
+ * Nodes are carved out of fixed-size blocks and are never freed one by one: clear() drops
+ * the whole tree in one step and keeps the blocks for the next parse.
+ */
+class AstArena {
+public:
+    /**
+     * @brief Allocates a node with no children.
+     * @param kind The kind of the node.
+     * @param tokenIndex Index of the token the node stands for, or NO_TOKEN.
+     * @return ASTNode* The new node, valid until clear() or the arena is destroyed.
+     */
+    ASTNode* make(NodeKind kind, uint32_t tokenIndex) {
+        if (cursor == limit) {
+            if (nextBlock == blocks.size()) {
+                blocks.push_back(std::make_unique<ASTNode[]>(BLOCK_NODES));
+                COMPILER_COUNT(COUNTER_ALLOCATED_BYTES, BLOCK_NODES * sizeof(ASTNode));
+            }
+            cursor = blocks[nextBlock++].get();
+            limit = cursor + BLOCK_NODES;
+        }
+        ASTNode* node = cursor++;
+        *node = { kind, tokenIndex };
+        COMPILER_COUNT(COUNTER_AST_NODES, 1);
+        return node;
+    }
+
+    /**
+     * @brief Releases every node at once. Blocks are kept and reused by later allocations.
+     */
+    void clear() {
+        nextBlock = 0;
+        cursor = limit = nullptr;
+    }
+
+private:
+    static constexpr size_t BLOCK_NODES = 256;          ///< Nodes per arena block
+
+    std::vector<std::unique_ptr<ASTNode[]>> blocks;     ///< Node storage
+    size_t nextBlock = 0;                               ///< Next block to start filling
+    ASTNode* cursor = nullptr;                          ///< Next free node in the current block
+    ASTNode* limit = nullptr;                           ///< End of the current block
+};
+
+
+// Compact AST layout
+/**
+ * @struct FlatAst
+ * @brief Abstract Syntax Tree stored as parallel arrays indexed by node number.
+ *
+ * Node 0 is the root. Children are linked by index (firstChild/nextSibling, NO_NODE at the
+ * end), and nodes are stored in the order they were added, so walking the tree is a linear
+ * sweep over contiguous memory and the arrays can be written out as they are.
+ */
+struct FlatAst {
+    std::vector<NodeKind> kinds;            ///< Kind of each node
+    std::vector<uint32_t> tokenIndices;     ///< Token index of each node, or NO_TOKEN
+    std::vector<uint32_t> firstChild;       ///< First child of each node, or NO_NODE
+    std::vector<uint32_t> nextSibling;      ///< Next sibling of each node, or NO_NODE
+
+    /**
+     * @brief Returns the number of nodes.
+     */
+    size_t size() const { return kinds.size(); }
+
+    /**
+     * @brief Reserves room for a number of nodes.
+     */
+    void reserve(size_t nodes) {
+        kinds.reserve(nodes);
+        tokenIndices.reserve(nodes);
+        firstChild.reserve(nodes);
+        nextSibling.reserve(nodes);
+        lastChild.reserve(nodes);
+    }
+
+    /**
+     * @brief Removes all nodes, keeping the allocated capacity.
+     */
+    void clear() {
+        kinds.clear();
+        tokenIndices.clear();
+        firstChild.clear();
+        nextSibling.clear();
+        lastChild.clear();
+    }
+
+    /**
+     * @brief Appends a node.
+     * @param parent Index of the parent node, or NO_NODE for the root.
+     * @param kind The kind of the node.
+     * @param tokenIndex Index of the token the node stands for, or NO_TOKEN.
+     * @return uint32_t Index of the new node.
+     */
+    uint32_t add(uint32_t parent, NodeKind kind, uint32_t tokenIndex) {
+        const uint32_t node = static_cast<uint32_t>(kinds.size());
+        COMPILER_COUNT(COUNTER_AST_NODES, 1);
+        kinds.push_back(kind);
+        tokenIndices.push_back(tokenIndex);
+        firstChild.push_back(NO_NODE);
+        nextSibling.push_back(NO_NODE);
+        lastChild.push_back(NO_NODE);
+
+        if (parent != NO_NODE) {
+            if (lastChild[parent] != NO_NODE) nextSibling[lastChild[parent]] = node;
+            else firstChild[parent] = node;
+            lastChild[parent] = node;
+        }
+        return node;
+    }
+
+private:
+    std::vector<uint32_t> lastChild;        ///< Last child of each node, only needed while building
+};
+
+
+// Builders used by the Parser to emit either tree layout
+/**
+ * @struct ArenaTreeBuilder
+ * @brief Parser builder policy that links ASTNodes allocated from an AstArena.
+ */
+struct ArenaTreeBuilder {
+    using Node = ASTNode*;
+    static constexpr Node none = nullptr;
+    static constexpr bool collectsTokens = true;    ///< The Parser records accepted tokens
+
+    AstArena& arena;
+    ASTNode* root = nullptr;                ///< First node added
+
+    Node add(Node parent, NodeKind kind, uint32_t tokenIndex) {
+        ASTNode* node = arena.make(kind, tokenIndex);
+        if (parent) parent->addChild(node);
+        else root = node;
+        return node;
+    }
+};
+
+/**
+ * @struct FlatAstBuilder
+ * @brief Parser builder policy that appends nodes to a FlatAst.
+ */
+struct FlatAstBuilder {
+    using Node = uint32_t;
+    static constexpr Node none = NO_NODE;
+    static constexpr bool collectsTokens = true;
+
+    FlatAst& ast;
+
+    Node add(Node parent, NodeKind kind, uint32_t tokenIndex) {
+        return ast.add(parent, kind, tokenIndex);
+    }
+};
+
+/**
+ * @struct NullBuilder
+ * @brief Parser builder policy that builds nothing, for validation-only parsing.
+ */
+struct NullBuilder {
+    using Node = int;
+    static constexpr Node none = 0;
+    static constexpr bool collectsTokens = false;
+
+    Node add(Node, NodeKind, uint32_t) { return 0; }
+};
+
+
+
+// Character classification
+/**
+ * @enum CharClass
+ * @brief Classes of input bytes as seen by the Lexer.
+ *
+ * Classification is plain ASCII (matching the "C" locale of the standard classifiers) and
+ * table based, so it is not affected by the process locale and can be inlined.
+ */
+enum CharClass : unsigned char { CC_SPACE, CC_UPPER, CC_LOWER, CC_COMMA, CC_HYPHEN, CC_STOP, CC_QUOTE, CC_OTHER,
+                                 CC_EOF,        ///< Pseudo class for the end of the input (never produced by the table)
+                                 CC_COUNT };
+
+/**
+ * @brief Builds the 256-entry byte to CharClass table at compile time.
+ * @return std::array<CharClass, 256> The class of every byte value.
+ */
+constexpr std::array<CharClass, 256> buildCharClassTable() {
+    std::array<CharClass, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        if (c == ' ' || (c >= '\t' && c <= '\r')) table[c] = CC_SPACE;
+        else if (c >= 'A' && c <= 'Z') table[c] = CC_UPPER;
+        else if (c >= 'a' && c <= 'z') table[c] = CC_LOWER;
+        else if (c == ',') table[c] = CC_COMMA;
+        else if (c == '-') table[c] = CC_HYPHEN;
+        else if (c == '.') table[c] = CC_STOP;
+        else if (c == '\'') table[c] = CC_QUOTE;
+        else table[c] = CC_OTHER;
+    }
+    return table;
+}
+
+constexpr std::array<CharClass, 256> charClassTable = buildCharClassTable();   ///< Class of every byte value
+
+inline CharClass charClass(char c) { return charClassTable[static_cast<unsigned char>(c)]; }
+inline bool isSpaceChar(char c) { return charClass(c) == CC_SPACE; }
+inline bool isLetterChar(char c) { return charClass(c) == CC_UPPER || charClass(c) == CC_LOWER; }
+inline bool isUpperChar(char c) { return charClass(c) == CC_UPPER; }
+
+/**
+ * @brief True for bytes that end an invalid run (whitespace, comma, hyphen or full stop).
+ */
+inline bool isRunDelimiter(char c) {
+    CharClass cls = charClass(c);
+    return cls == CC_SPACE || cls == CC_COMMA || cls == CC_HYPHEN || cls == CC_STOP;
+}
+
+
+// Scanning kernels
+/**
+ * @struct ScanKernels
+ * @brief Set of boundary-finding functions used by the Lexer.
+ *
+ * Each kernel takes a buffer and a half-open range [pos, end) and returns the index of the
+ * first byte in the range that does not belong to the run being skipped, or end if the run
+ * reaches it. All implementations return identical results; they differ only in how many
+ * bytes they classify per step.
+ */
+struct ScanKernels {
+    const char* name;                                       ///< Instruction set, for diagnostics
+    size_t (*skipSpaces)(const char*, size_t, size_t);      ///< Skips whitespace
+    size_t (*skipLetters)(const char*, size_t, size_t);     ///< Skips ASCII letters
+    size_t (*skipInvalid)(const char*, size_t, size_t);     ///< Skips up to the next whitespace, comma, hyphen or stop
+};
+
+size_t skipSpacesScalar(const char* data, size_t pos, size_t end) {
+    while (pos < end && isSpaceChar(data[pos])) pos++;
+    return pos;
+}
+
+size_t skipLettersScalar(const char* data, size_t pos, size_t end) {
+    while (pos < end && isLetterChar(data[pos])) pos++;
+    return pos;
+}
+
+size_t skipInvalidScalar(const char* data, size_t pos, size_t end) {
+    while (pos < end && !isRunDelimiter(data[pos])) pos++;
+    return pos;
+}
+
+const ScanKernels scalarScanKernels = { "scalar", skipSpacesScalar, skipLettersScalar, skipInvalidScalar };
+
+#ifdef LEXER_HAVE_SSE2
+// Lanes are 0xFF where the byte belongs to the run; the kernels stop at the first zero lane.
+inline __m128i spaceMask16(__m128i v) {
+    __m128i ctrl = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+    return _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+inline __m128i letterMask16(__m128i v) {
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));  // Fold upper case onto lower case
+    return _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(folded, _mm_set1_epi8('z' + 1)));
+}
+
+inline __m128i nonDelimiterMask16(__m128i v) {
+    __m128i delim = _mm_or_si128(spaceMask16(v), _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(',')),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('.')))));
+    return _mm_xor_si128(delim, _mm_set1_epi8(-1));
+}
+
+template <__m128i (*InRun)(__m128i), size_t (*Tail)(const char*, size_t, size_t)>
+size_t skipRunSSE2(const char* data, size_t pos, size_t end) {
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        unsigned stops = ~static_cast<unsigned>(_mm_movemask_epi8(InRun(v))) & 0xFFFFu;
+        if (stops) return pos + __builtin_ctz(stops);
+    }
+    return Tail(data, pos, end);
+}
+
+const ScanKernels sse2ScanKernels = {
+    "sse2",
+    skipRunSSE2<spaceMask16, skipSpacesScalar>,
+    skipRunSSE2<letterMask16, skipLettersScalar>,
+    skipRunSSE2<nonDelimiterMask16, skipInvalidScalar>,
+};
+#endif
+
+#ifdef LEXER_HAVE_AVX2
+#define LEXER_AVX2_TARGET __attribute__((target("avx2")))
+
+LEXER_AVX2_TARGET inline __m256i spaceMask32(__m256i v) {
+    __m256i ctrl = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+    return _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+LEXER_AVX2_TARGET inline __m256i letterMask32(__m256i v) {
+    __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return _mm256_and_si256(_mm256_cmpgt_epi8(folded, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), folded));
+}
+
+LEXER_AVX2_TARGET inline __m256i nonDelimiterMask32(__m256i v) {
+    __m256i delim = _mm256_or_si256(spaceMask32(v), _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')))));
+    return _mm256_xor_si256(delim, _mm256_set1_epi8(-1));
+}
+
+#define LEXER_DEFINE_AVX2_SKIP(NAME, MASK, TAIL)                                                    \
+    LEXER_AVX2_TARGET size_t NAME(const char* data, size_t pos, size_t end) {                       \
+        for (; pos + 32 <= end; pos += 32) {                                                        \
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));           \
+            unsigned stops = ~static_cast<unsigned>(_mm256_movemask_epi8(MASK(v)));                 \
+            if (stops) return pos + __builtin_ctz(stops);                                           \
+        }                                                                                           \
+        return TAIL(data, pos, end);                                                                \
+    }
+
+// Tails of under 32 bytes go through the SSE2 kernels before the scalar loop
+LEXER_DEFINE_AVX2_SKIP(skipSpacesAVX2, spaceMask32, (skipRunSSE2<spaceMask16, skipSpacesScalar>))
+LEXER_DEFINE_AVX2_SKIP(skipLettersAVX2, letterMask32, (skipRunSSE2<letterMask16, skipLettersScalar>))
+LEXER_DEFINE_AVX2_SKIP(skipInvalidAVX2, nonDelimiterMask32, (skipRunSSE2<nonDelimiterMask16, skipInvalidScalar>))
+
+const ScanKernels avx2ScanKernels = { "avx2", skipSpacesAVX2, skipLettersAVX2, skipInvalidAVX2 };
+#endif
+
+#ifdef LEXER_HAVE_NEON
+inline uint8x16_t spaceMask16(uint8x16_t v) {
+    uint8x16_t ctrl = vandq_u8(vcgeq_u8(v, vdupq_n_u8('\t')), vcleq_u8(v, vdupq_n_u8('\r')));
+    return vorrq_u8(ctrl, vceqq_u8(v, vdupq_n_u8(' ')));
+}
+
+inline uint8x16_t letterMask16(uint8x16_t v) {
+    uint8x16_t folded = vorrq_u8(v, vdupq_n_u8(0x20));
+    return vandq_u8(vcgeq_u8(folded, vdupq_n_u8('a')), vcleq_u8(folded, vdupq_n_u8('z')));
+}
+
+inline uint8x16_t nonDelimiterMask16(uint8x16_t v) {
+    uint8x16_t delim = vorrq_u8(spaceMask16(v), vorrq_u8(vceqq_u8(v, vdupq_n_u8(',')),
+                       vorrq_u8(vceqq_u8(v, vdupq_n_u8('-')), vceqq_u8(v, vdupq_n_u8('.')))));
+    return vmvnq_u8(delim);
+}
+
+template <uint8x16_t (*InRun)(uint8x16_t), size_t (*Tail)(const char*, size_t, size_t)>
+size_t skipRunNEON(const char* data, size_t pos, size_t end) {
+    for (; pos + 16 <= end; pos += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(data + pos));
+        // Narrow each lane to 4 bits so the result fits in a 64-bit scalar mask
+        uint64_t stops = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(InRun(v)), 4)), 0);
+        if (stops) return pos + (__builtin_ctzll(stops) >> 2);
+    }
+    return Tail(data, pos, end);
+}
+
+const ScanKernels neonScanKernels = {
+    "neon",
+    skipRunNEON<spaceMask16, skipSpacesScalar>,
+    skipRunNEON<letterMask16, skipLettersScalar>,
+    skipRunNEON<nonDelimiterMask16, skipInvalidScalar>,
+};
+#endif
+
+/**
+ * @brief Picks the widest scanning kernels the running CPU supports.
+ * @return const ScanKernels& The kernels selected on first use.
+ */
+const ScanKernels& scanKernels() {
+    static const ScanKernels& selected = []() -> const ScanKernels& {
+#ifdef LEXER_HAVE_AVX2
+        if (__builtin_cpu_supports("avx2")) return avx2ScanKernels;
+#endif
+#if defined(LEXER_HAVE_SSE2)
+        return sse2ScanKernels;
+#elif defined(LEXER_HAVE_NEON)
+        return neonScanKernels;
+#else
+        return scalarScanKernels;
+#endif
+    }();
+    return selected;
+}
+
+
+
+// Lexer DFA
+/**
+ * @enum LexState
+ * @brief States of the deterministic automaton that recognizes one token.
+ *
+ * A letter run is tracked by its length (LS_WORD_1 .. LS_WORD_26), so the 3-26 length rule and
+ * the split at 26 characters are part of the automaton instead of being checked afterwards.
+ * States from LS_ACCEPT onwards are final: the driver stops and emits a token as soon as it
+ * enters one.
+ */
+enum LexState : unsigned char {
+    LS_START,                   ///< Before the first byte of a token
+    LS_QUOTED,                  ///< Inside a quotation
+    LS_INVALID_RUN,             ///< Inside a run of invalid characters
+    LS_WORD_1,                  ///< Inside a letter run, LS_WORD_1 + n - 1 after n letters
+    LS_WORD_26 = LS_WORD_1 + 25,
+
+    LS_ACCEPT,                  ///< First final state
+    LS_ACC_END = LS_ACCEPT,     ///< No input left
+    LS_ACC_COMMA,
+    LS_ACC_HYPHEN,
+    LS_ACC_STOP,
+    LS_ACC_QUOTATION,           ///< Closing quote seen
+    LS_ACC_OPEN_QUOTATION,      ///< Input ended inside a quotation
+    LS_ACC_WORD,                ///< Letter run of 3-26 characters
+    LS_ACC_SPLIT_WORD,          ///< 27th letter seen; the first 26 are emitted on their own
+    LS_ACC_SHORT_WORD,          ///< Letter run of 1-2 characters
+    LS_ACC_INVALID,             ///< End of an invalid run
+    LS_COUNT
+};
+
+/**
+ * @struct LexAccept
+ * @brief What a final state emits.
+ *
+ * The token value is the byte range from the token start to the driver position, after the
+ * terminating byte is consumed (if consume is set), with trimLeading/trimTrailing bytes
+ * removed at either end (the quotes of a quotation).
+ */
+struct LexAccept {
+    TokenType type;
+    bool consume;                   ///< The byte that led to this state belongs to the token
+    unsigned char trimLeading;
+    unsigned char trimTrailing;
+};
+
+/**
+ * @brief Builds the transition table of the lexer automaton at compile time.
+ * @return Table indexed by [non-final LexState][CharClass] giving the next LexState.
+ */
+constexpr std::array<std::array<LexState, CC_COUNT>, LS_ACCEPT> buildLexTransitions() {
+    std::array<std::array<LexState, CC_COUNT>, LS_ACCEPT> table{};
+
+    for (int cls = 0; cls < CC_COUNT; ++cls) {
+        const bool letter = cls == CC_UPPER || cls == CC_LOWER;
+        const bool delimiter = cls == CC_SPACE || cls == CC_COMMA || cls == CC_HYPHEN || cls == CC_STOP || cls == CC_EOF;
+
+        // Start of a token
+        LexState start = LS_INVALID_RUN;
+        if (cls == CC_SPACE) start = LS_START;
+        else if (letter) start = LS_WORD_1;
+        else if (cls == CC_COMMA) start = LS_ACC_COMMA;
+        else if (cls == CC_HYPHEN) start = LS_ACC_HYPHEN;
+        else if (cls == CC_STOP) start = LS_ACC_STOP;
+        else if (cls == CC_QUOTE) start = LS_QUOTED;
+        else if (cls == CC_EOF) start = LS_ACC_END;
+        table[LS_START][cls] = start;
+
+        // Quotations run to the closing quote or the end of the input
+        table[LS_QUOTED][cls] = cls == CC_QUOTE ? LS_ACC_QUOTATION : cls == CC_EOF ? LS_ACC_OPEN_QUOTATION : LS_QUOTED;
+
+        // Invalid runs swallow everything up to whitespace or punctuation (quotes and letters included)
+        table[LS_INVALID_RUN][cls] = delimiter ? LS_ACC_INVALID : LS_INVALID_RUN;
+
+        // Letter runs count their length up to the split point
+        for (int state = LS_WORD_1; state <= LS_WORD_26; ++state) {
+            const int length = state - LS_WORD_1 + 1;
+            if (letter) table[state][cls] = state == LS_WORD_26 ? LS_ACC_SPLIT_WORD : static_cast<LexState>(state + 1);
+            else table[state][cls] = length < 3 ? LS_ACC_SHORT_WORD : LS_ACC_WORD;
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::array<LexState, CC_COUNT>, LS_ACCEPT> lexTransitions = buildLexTransitions();   ///< Lexer DFA
+
+/// Token emitted by each final state, indexed by state - LS_ACCEPT
+constexpr std::array<LexAccept, LS_COUNT - LS_ACCEPT> lexAccepts = {{
+    { END,       false, 0, 0 },     // LS_ACC_END
+    { COMMA,     true,  0, 0 },     // LS_ACC_COMMA
+    { HYPHEN,    true,  0, 0 },     // LS_ACC_HYPHEN
+    { STOP,      true,  0, 0 },     // LS_ACC_STOP
+    { QUOTATION, true,  1, 1 },     // LS_ACC_QUOTATION
+    { QUOTATION, false, 1, 0 },     // LS_ACC_OPEN_QUOTATION
+    { WORD,      false, 0, 0 },     // LS_ACC_WORD (STARTWORD when the first letter is upper case)
+    { WORD,      false, 0, 0 },     // LS_ACC_SPLIT_WORD
+    { INVALID,   false, 0, 0 },     // LS_ACC_SHORT_WORD
+    { INVALID,   false, 0, 0 },     // LS_ACC_INVALID
+}};
+
+static_assert(lexTransitions[LS_START][CC_EOF] == LS_ACC_END, "Empty input must produce END");
+static_assert(lexTransitions[LS_WORD_1 + 1][CC_SPACE] == LS_ACC_SHORT_WORD, "Words need at least 3 letters");
+static_assert(lexTransitions[LS_WORD_1 + 2][CC_EOF] == LS_ACC_WORD, "3-letter runs are words");
+static_assert(lexTransitions[LS_WORD_26][CC_STOP] == LS_ACC_WORD, "26-letter runs are words");
+static_assert(lexTransitions[LS_WORD_26][CC_LOWER] == LS_ACC_SPLIT_WORD, "Runs over 26 letters are split");
+static_assert(lexTransitions[LS_WORD_1][CC_QUOTE] == LS_ACC_SHORT_WORD, "A quote ends a letter run");
+static_assert(lexTransitions[LS_INVALID_RUN][CC_QUOTE] == LS_INVALID_RUN, "Invalid runs end only at delimiters");
+static_assert(lexAccepts[LS_ACC_SPLIT_WORD - LS_ACCEPT].type == WORD && lexAccepts[LS_ACC_INVALID - LS_ACCEPT].type == INVALID,
+              "lexAccepts must follow LexState order");
+
+
+
+// Hash function for byte strings
+/**
+ * @brief Computes the 64-bit FNV-1a hash of a byte string.
+ * @param bytes The bytes to hash.
+ * @return uint64_t The hash value.
+ */
+inline uint64_t hashBytes(std::string_view bytes) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : bytes) {
+        hash = (hash ^ c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Computes a 64-bit hash of a byte string eight bytes at a time.
+ * @param bytes The bytes to hash.
+ * @return uint64_t The hash value.
+ *
+ * Faster than hashBytes() on whole sentences; each 64-bit word is folded in with a multiply
+ * and a shift, and the result goes through the splitmix64 finalizer.
+ */
+inline uint64_t hashWords(std::string_view bytes) {
+    const char* data = bytes.data();
+    size_t left = bytes.size();
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ left;
+    for (; left >= 8; data += 8, left -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    if (left > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, data, left);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    return hash ^ (hash >> 31);
+}
+
+
+// Symbol table storing each distinct word once
+/**
+ * @class SymbolTable
+ * @brief Interning table that maps words to dense 32-bit symbol ids.
+ *
+ * Each distinct word is copied once into an arena of fixed-size blocks, and looked up through
+ * an open-addressing hash map with linear probing. Ids are handed out in first-seen order and
+ * the table counts how often each word was interned.
+ */
+class SymbolTable {
+public:
+    /**
+     * @brief Returns the id of a word, adding the word if it has not been seen before.
+     * @param word The word to intern. It is copied, so the caller's buffer may go away.
+     * @return uint32_t The symbol id of the word.
+     */
+    uint32_t intern(std::string_view word) {
+        if ((entries.size() + 1) * 4 > slots.size() * 3) {
+            grow();                                         // Keep the load factor under 3/4
+        }
+
+        const uint64_t hash = hashBytes(word);
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+            uint32_t index = slots[slot];
+            if (index == 0) {
+                entries.push_back({ store(word), hash, 1 });
+                slots[slot] = static_cast<uint32_t>(entries.size());
+                return static_cast<uint32_t>(entries.size() - 1);
+            }
+            Entry& entry = entries[index - 1];
+            if (entry.hash == hash && entry.text == word) {
+                entry.count++;
+                return index - 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the text of a symbol.
+     * @param id A symbol id returned by intern().
+     */
+    std::string_view name(uint32_t id) const { return entries[id].text; }
+
+    /**
+     * @brief Returns how many times a symbol was interned.
+     * @param id A symbol id returned by intern().
+     */
+    uint32_t count(uint32_t id) const { return entries[id].count; }
+
+    /**
+     * @brief Returns the number of distinct symbols.
+     */
+    size_t size() const { return entries.size(); }
+
+    /**
+     * @brief Removes every symbol. The hash slots and pool blocks are kept for reuse.
+     */
+    void clear() {
+        entries.clear();
+        std::fill(slots.begin(), slots.end(), 0);
+        largeBlocks.clear();
+        nextBlock = 0;
+        blockUsed = BLOCK_SIZE;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 4096;          ///< Size of each arena block
+
+    /**
+     * @struct Entry
+     * @brief A distinct symbol: its pooled text, cached hash and occurrence count.
+     */
+    struct Entry {
+        std::string_view text;
+        uint64_t hash;
+        uint32_t count;
+    };
+
+    std::vector<Entry> entries;                         ///< Symbols indexed by id
+    std::vector<uint32_t> slots;                        ///< Hash slots holding id + 1, 0 when empty
+    std::vector<std::unique_ptr<char[]>> blocks;        ///< String pool arena blocks
+    std::vector<std::unique_ptr<char[]>> largeBlocks;   ///< Blocks holding one string longer than BLOCK_SIZE
+    size_t nextBlock = 0;                               ///< Next pool block to start filling
+    size_t blockUsed = BLOCK_SIZE;                      ///< Bytes used in the current block
+
+    /**
+     * @brief Copies a word into the string pool.
+     * @return std::string_view View of the pooled copy, stable for the lifetime of the table.
+     */
+    std::string_view store(std::string_view word) {
+        char* text;
+        if (word.size() > BLOCK_SIZE) {
+            // Oversized strings get a block of their own
+            largeBlocks.push_back(std::make_unique<char[]>(word.size()));
+            COMPILER_COUNT(COUNTER_ALLOCATED_BYTES, word.size());
+            text = largeBlocks.back().get();
+        } else {
+            if (BLOCK_SIZE - blockUsed < word.size()) {
+                if (nextBlock == blocks.size()) {
+                    blocks.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+                    COMPILER_COUNT(COUNTER_ALLOCATED_BYTES, BLOCK_SIZE);
+                }
+                nextBlock++;
+                blockUsed = 0;
+            }
+            text = blocks[nextBlock - 1].get() + blockUsed;
+            blockUsed += word.size();
+        }
+        std::memcpy(text, word.data(), word.size());
+        return { text, word.size() };
+    }
+
+    /**
+     * @brief Doubles the hash map and reinserts every symbol using its cached hash.
+     */
+    void grow() {
+        std::vector<uint32_t> bigger(std::max<size_t>(16, slots.size() * 2), 0);
+        COMPILER_COUNT(COUNTER_ALLOCATED_BYTES, bigger.size() * sizeof(uint32_t));
+        const size_t mask = bigger.size() - 1;
+        for (uint32_t index = 0; index < entries.size(); ++index) {
+            size_t slot = entries[index].hash & mask;
+            while (bigger[slot] != 0) slot = (slot + 1) & mask;
+            bigger[slot] = index + 1;
+        }
+        slots.swap(bigger);
+    }
+};
+
+
+
+// Parse status enumeration
+/**
+ * @enum ParseStatus
+ * @brief Outcome of parsing a sentence: success or the rule that rejected it.
+ */
+enum ParseStatus : unsigned char {
+    PARSE_OK,
+    PARSE_EXPECTED_STARTWORD,       ///< The first token is not a Startword
+    PARSE_CONSECUTIVE_COMMAS,
+    PARSE_CONSECUTIVE_HYPHENS,
+    PARSE_UNEXPECTED_TOKEN,         ///< A token that cannot appear inside a sentence
+    PARSE_EXPECTED_STOP,            ///< The tokens ran out before a Stop
+    PARSE_EXTRA_TOKENS,             ///< Tokens follow the Stop
+    PARSE_LEXICAL_ERRORS,           ///< The sentence is well formed but the Lexer found invalid tokens
+    PARSE_INVALID_TOKEN             ///< One invalid token (reported by the recovering mode only)
+};
+
+
+// Validation result structure
+/**
+ * @struct ValidationResult
+ * @brief Compact parse outcome: a status and the index of the token where it was detected.
+ */
+struct ValidationResult {
+    ParseStatus status;
+    uint32_t tokenIndex;            ///< Offending token, tokens.size() at the end of input, or NO_TOKEN
+
+    /**
+     * @brief Checks whether the sentence was accepted.
+     */
+    bool ok() const { return status == PARSE_OK; }
+};
+
+
+// Diagnostic structure
+/**
+ * @struct Diagnostic
+ * @brief One problem found in an input, as a code and a location; its message is only
+ *        formatted when asked for (describeDiagnostic(), writeDiagnostic()).
+ */
+struct Diagnostic {
+    ParseStatus status;
+    uint32_t tokenIndex;            ///< Offending valid token, tokens.size() at the end, or NO_TOKEN for invalid tokens
+    size_t offset;                  ///< Byte offset of the offending token, or the end of the last valid token at the end
+    std::string_view text;          ///< Text of the offending token (empty at the end of input)
+};
+
+
+// Helper function to look up the message of a status
+/**
+ * @brief Returns the fixed part of the error message for a status.
+ * @param status A failure status.
+ * @param quotesToken Set if the message ends with the text of the offending token.
+ * @return std::string_view The message text, or an empty view for PARSE_OK.
+ */
+inline std::string_view parseErrorText(ParseStatus status, bool& quotesToken) {
+    quotesToken = status == PARSE_EXPECTED_STARTWORD || status == PARSE_UNEXPECTED_TOKEN || status == PARSE_INVALID_TOKEN;
+    switch (status) {
+        case PARSE_EXPECTED_STARTWORD: return "Expected Startword, got: ";
+        case PARSE_CONSECUTIVE_COMMAS: return "Error: Consecutive commas found.";
+        case PARSE_CONSECUTIVE_HYPHENS: return "Error: Consecutive hyphens found.";
+        case PARSE_UNEXPECTED_TOKEN: return "Unexpected token: ";
+        case PARSE_EXPECTED_STOP: return "Expected STOP at the end";
+        case PARSE_EXTRA_TOKENS: return "Error: Extra tokens found after full stop.";
+        case PARSE_LEXICAL_ERRORS: return "Error: Lexical errors found. Invalid tokens in the sentence.";
+        case PARSE_INVALID_TOKEN: return "Invalid token: ";
+        default: return "";
+    }
+}
+
+// Helper function to format a parse error message
+/**
+ * @brief Builds the error message the Parser reports for a status.
+ * @param status A failure status.
+ * @param tokenText Text of the offending token (used by the messages that quote it).
+ * @return std::string The message, or an empty string for PARSE_OK.
+ */
+std::string describeParseError(ParseStatus status, std::string_view tokenText) {
+    bool quotesToken;
+    std::string message(parseErrorText(status, quotesToken));
+    if (quotesToken) message.append(tokenText);
+    return message;
+}
+
+/**
+ * @brief Prints the error message for a status without building a string.
+ * @param out Where to print.
+ * @param status A failure status.
+ * @param tokenText Text of the offending token.
+ */
+void writeParseError(OutputSink& out, ParseStatus status, std::string_view tokenText) {
+    bool quotesToken;
+    out << parseErrorText(status, quotesToken);
+    if (quotesToken) out << tokenText;
+}
+
+/**
+ * @brief Builds the message of a diagnostic.
+ */
+std::string describeDiagnostic(const Diagnostic& diagnostic) {
+    return describeParseError(diagnostic.status, diagnostic.text);
+}
+
+/**
+ * @brief Prints the message of a diagnostic.
+ */
+void writeDiagnostic(OutputSink& out, const Diagnostic& diagnostic) {
+    writeParseError(out, diagnostic.status, diagnostic.text);
+}
+
+/**
+ * @brief Builds the message of a diagnostic prefixed with its "line:column: " position.
+ * @param diagnostic The diagnostic.
+ * @param lines Line index over the input the diagnostic refers to.
+ */
+std::string describeDiagnostic(const Diagnostic& diagnostic, const LineIndex& lines) {
+    const LineIndex::Position position = lines.locate(diagnostic.offset);
+    return std::to_string(position.line) + ":" + std::to_string(position.column) + ": " + describeDiagnostic(diagnostic);
+}
+
+/**
+ * @brief Prints the message of a diagnostic prefixed with its "line:column: " position.
+ * @param out Where to print.
+ * @param diagnostic The diagnostic.
+ * @param lines Line index over the input the diagnostic refers to.
+ */
+void writeDiagnostic(OutputSink& out, const Diagnostic& diagnostic, const LineIndex& lines) {
+    const LineIndex::Position position = lines.locate(diagnostic.offset);
+    out.writeNumber(position.line);
+    out << ':';
+    out.writeNumber(position.column);
+    out << ": ";
+    writeDiagnostic(out, diagnostic);
+}
+
+
+
+
+// Per-compilation error state
+/**
+ * @struct CompilationContext
+ * @brief Diagnostics of one compilation, shared by its Lexer and Parser.
+ *
+ * Each compilation owns its context, so separate Lexer/Parser pairs (for example one per
+ * worker thread) share no mutable state. reset() empties it for the next input while keeping
+ * the allocated capacity. Errors are kept as Diagnostic records whose text points into the
+ * input; messages are formatted only when printed or described.
+ */
+struct CompilationContext {
+    std::vector<Diagnostic> lexicalErrors;      ///< Invalid tokens (PARSE_INVALID_TOKEN), filled by the Lexer
+    std::vector<Diagnostic> parseErrors;        ///< Errors encountered during parsing
+
+    /**
+     * @brief Forgets the diagnostics of the previous compilation.
+     */
+    void reset() {
+        lexicalErrors.clear();
+        parseErrors.clear();
+    }
+};
+
+
+
+// Lexer class to tokenize input strings
+/**
+ * @class Lexer
+ * @brief The Lexer class tokenizes input strings based on lexical specifications.
+ *
+ * It processes input character by character and generates tokens such as words, punctuation, and quotations.
+ * Errors are raised for invalid tokens, and a symbol table is built for valid words.
+ */
+class Lexer {
+public:
+    // Constructor
+    /**
+     * @brief Constructs a Lexer over the provided input buffer.
+     * @param input The input to tokenize. The buffer is borrowed, not copied, and must outlive
+     *              the Lexer and every Token it returns.
+     * @param context Compilation context that receives the lexical errors.
+     */
+    Lexer(std::string_view input, CompilationContext& context) : input(input), pos(0), scan(&scanKernels()), context(context) {}
+
+    // Method to start over on a new input
+    /**
+     * @brief Points the Lexer at a new input and clears the symbol table.
+     * @param newInput The next input to tokenize (borrowed, as in the constructor).
+     *
+     * The symbol table keeps its allocated storage, so a reused Lexer does not allocate once
+     * it has seen inputs of similar size.
+     */
+    void reset(std::string_view newInput) {
+        input = newInput;
+        pos = 0;
+        symbolTable.clear();
+    }
+
+    // Method to get the next token from input
+    /**
+     * @brief Retrieves the next token from the input string.
+     * @return Token The next token in the input stream.
+     *
+     * This function skips whitespaces, identifies valid tokens such as words, punctuation, or quotations, 
+     * and splits words longer than 26 characters. Invalid tokens are also handled and returned.
+     */
+    Token nextToken() {
+        size_t start;
+        const unsigned state = scanToken(start);
+        return acceptToken(state, start);
+    }
+
+    // Method to get the next token only if no later input could change it
+    /**
+     * @brief Retrieves the next token if it ends before the end of the input seen so far.
+     * @param token Receives the token.
+     * @return bool False if the token reaches the end of the input, so that more bytes could
+     *         still extend or change it; the position is then left at the start of that token.
+     *
+     * Used when the input is a prefix of a longer stream: a token is final once the automaton
+     * accepts it on a real byte rather than on the end of the input. Incomplete words are not
+     * added to the symbol table.
+     */
+    bool nextCompleteToken(Token& token) {
+        size_t start;
+        const unsigned state = scanToken(start);
+        if (pos == input.length() && !lexAccepts[state - LS_ACCEPT].consume) {
+            pos = start;
+            return false;
+        }
+        token = acceptToken(state, start);
+        return true;
+    }
+
+    // Method to continue on the next part of a stream
+    /**
+     * @brief Points the Lexer at a new input, keeping the symbol table.
+     * @param newInput The next input to tokenize (borrowed, as in the constructor).
+     */
+    void resume(std::string_view newInput) {
+        input = newInput;
+        pos = 0;
+    }
+
+    /**
+     * @brief Returns the offset in the current input that the next token is read from.
+     */
+    size_t position() const { return pos; }
+
+    /**
+     * @brief Turns adding words to the symbol table on or off (it is on by default).
+     * @param enabled False to leave Token::symbol at NO_SYMBOL, for callers that only check
+     *                the token sequence and would otherwise grow the table with the vocabulary.
+     */
+    void setInterning(bool enabled) { interning = enabled; }
+
+    // Method to tokenize the whole input at once
+    /**
+     * @brief Tokenizes the rest of the input in a single pass.
+     * @param tokens Vector that receives every valid token, in input order (existing contents are kept).
+     * @return size_t The number of tokens appended to @p tokens.
+     *
+     * The token vector is reserved up front from a byte scan of the input, so it never
+     * reallocates while tokenizing. Invalid tokens are diverted in the same pass: each one adds
+     * a PARSE_INVALID_TOKEN record to the context's lexicalErrors.
+     */
+    size_t tokenizeAll(std::vector<Token>& tokens) {
+        COMPILER_TIME_PHASE(PHASE_LEX);
+        const size_t before = tokens.size();
+        const size_t capacity = tokens.capacity();
+        tokens.reserve(before + estimateTokenCount());
+        COMPILER_COUNT(COUNTER_ALLOCATED_BYTES, (tokens.capacity() - capacity) * sizeof(Token));
+
+        for (Token token = nextToken(); token.type != END; token = nextToken()) {
+            if (token.type == INVALID) {
+                context.lexicalErrors.push_back({ PARSE_INVALID_TOKEN, NO_TOKEN, token.offset, token.value });
+            } else {
+                tokens.push_back(token);
+            }
+        }
+        return tokens.size() - before;
+    }
+
+    // Method to tokenize the whole input into the packed representation
+    /**
+     * @brief Tokenizes the rest of the input like tokenizeAll(), into 8-byte PackedTokens.
+     * @param tokens Stream that receives every valid token (existing contents are replaced); it
+     *               is pointed at this Lexer's input.
+     * @param error Receives the reason if the input cannot be packed.
+     * @return bool False, with nothing appended, if the input is longer than
+     *         PackedTokenStream::MAX_INPUT, since offsets are 32-bit.
+     */
+    bool tokenizePacked(PackedTokenStream& tokens, std::string& error) {
+        if (input.size() > PackedTokenStream::MAX_INPUT) {
+            error = "input of " + std::to_string(input.size()) + " bytes is too large for the 32-bit offsets of packed tokens";
+            return false;
+        }
+        COMPILER_TIME_PHASE(PHASE_LEX);
+        tokens.clear();
+        tokens.setInput(input);
+        tokens.reserve(estimateTokenCount());
+
+        for (Token token = nextToken(); token.type != END; token = nextToken()) {
+            if (token.type == INVALID) {
+                context.lexicalErrors.push_back({ PARSE_INVALID_TOKEN, NO_TOKEN, token.offset, token.value });
+            } else {
+                tokens.push(token, static_cast<uint32_t>(token.offset + (token.type == QUOTATION ? 1 : 0)));
+            }
+        }
+        return true;
+    }
+
+    
+    // Display symbol table
+    /**
+     * @brief Prints the symbol table generated during tokenization.
+     * @param withCounts Also print how many times each symbol occurred.
+     * @param out Where to print.
+     *
+     * Each distinct word is listed once, in the order it was first seen.
+     */
+    void printSymbolTable(bool withCounts = false, OutputSink& out = standardOutput()) const {
+        out << "\nSymbol Table: \n";
+        for (uint32_t id = 0; id < symbolTable.size(); ++id) {
+            out << symbolTable.name(id);
+            if (withCounts) {
+                out << " (";
+                out.writeNumber(symbolTable.count(id));
+                out << ")";
+            }
+            out << '\n';
+        }
+    }
+
+    /**
+     * @brief Returns the symbol table built so far.
+     * @return const SymbolTable& Table that Token::symbol ids refer to.
+     */
+    const SymbolTable& symbols() const { return symbolTable; }
+
+private:
+    // Runs the automaton over the next token, stopping just before the byte that ended it
+    unsigned scanToken(size_t& start) {
+        const char* data = input.data();
+        const size_t length = input.length();
+
+        // Skip whitespace (the self-loop of LS_START)
+        if (pos < length && isSpaceChar(data[pos])) {
+            pos = scan->skipSpaces(data, pos + 1, length);
+        }
+
+        // Run the automaton. Self-loops are taken in one step by the scanning kernels, so each
+        // token costs a few table lookups however long it is.
+        start = pos;
+        unsigned state = LS_START;
+        for (;;) {
+            const CharClass cls = pos < length ? charClass(data[pos]) : CC_EOF;
+            state = lexTransitions[state][cls];
+            if (state >= LS_ACCEPT) break;
+
+            pos++;
+            if (state == LS_QUOTED) {
+                const void* close = std::memchr(data + pos, '\'', length - pos);
+                pos = close ? static_cast<const char*>(close) - data : length;
+            } else if (state == LS_INVALID_RUN) {
+                pos = scan->skipInvalid(data, pos, length);
+            } else if (state == LS_WORD_1) {
+                // Only the first 27 letters of a run are needed to decide whether it has to be split
+                size_t run = scan->skipLetters(data, pos, std::min(length, start + 27)) - start;
+                run = std::min<size_t>(run, 26);
+                state = LS_WORD_1 + run - 1;
+                pos = start + run;
+            }
+        }
+        return state;
+    }
+
+    // Emits the token of a final state reached from start
+    Token acceptToken(unsigned state, size_t start) {
+        const LexAccept& accept = lexAccepts[state - LS_ACCEPT];
+        if (accept.consume) pos++;
+        const std::string_view value = input.substr(start + accept.trimLeading, pos - start - accept.trimLeading - accept.trimTrailing);
+
+        if (state == LS_ACC_WORD) {
+            // Add to symbol table
+            const TokenType type = isUpperChar(value[0]) ? STARTWORD : WORD;
+            COMPILER_COUNT(COUNTER_TOKENS + type, 1);
+            return { type, value, interning ? symbolTable.intern(value) : NO_SYMBOL, start };
+        }
+        COMPILER_COUNT(COUNTER_TOKENS + accept.type, 1);
+        COMPILER_COUNT(COUNTER_SPLIT_WORDS, state == LS_ACC_SPLIT_WORD ? 1 : 0);
+        return { accept.type, value, NO_SYMBOL, start };
+    }
+
+    /**
+     * @brief Computes an upper bound on the number of tokens left in the input.
+     * @return size_t Number of positions at which a token may start.
+     *
+     * A token can only start at a punctuation mark or quote, at the first non-space byte after a
+     * space, punctuation mark or quote, where a letter run begins or ends, or every 26 letters
+     * inside a letter run (long-word splitting).
+     */
+    size_t estimateTokenCount() const {
+        size_t count = 0;
+        size_t letterRun = 0;
+        bool boundary = true;                  // Previous byte ends any token in progress
+        bool prevAlpha = false;
+
+        for (size_t i = pos; i < input.length(); ++i) {
+            const char c = input[i];
+            const bool alpha = isLetterChar(c);
+            if (isSpaceChar(c)) {
+                boundary = true;
+                letterRun = 0;
+                prevAlpha = false;
+                continue;
+            }
+            if (c == ',' || c == '-' || c == '.' || c == '\'') {
+                count++;
+                boundary = true;
+                letterRun = 0;
+                prevAlpha = false;
+                continue;
+            }
+            letterRun = alpha ? letterRun + 1 : 0;
+            if (boundary || alpha != prevAlpha || (letterRun > 26 && letterRun % 26 == 1)) {
+                count++;
+            }
+            boundary = false;
+            prevAlpha = alpha;
+        }
+        return count;
+    }
+
+    std::string_view input;                ///< Borrowed input buffer to be tokenized
+    size_t pos;                            ///< Current position in the input string
+    const ScanKernels* scan;               ///< Boundary-finding kernels selected for this CPU
+    CompilationContext& context;           ///< Receives lexical errors
+    SymbolTable symbolTable;               ///< Symbol table to store valid words
+    bool interning = true;                 ///< Words are added to symbolTable
+
+};
+
+
+
+
+// Lexer for input that arrives in pieces
+/**
+ * @class ChunkedLexer
+ * @brief Tokenizes a stream fed chunk by chunk, giving the same tokens as a one-shot Lexer.
+ *
+ * Tokens that end inside a chunk are emitted straight from it. A token cut off by the end of
+ * a chunk (a word, quotation or invalid run whose end has not been seen yet) is carried over
+ * and lexed again once more input has arrived. The carry is only rescanned after it has
+ * doubled in size, so a very long token costs linear time in total; memory stays within the
+ * chunk size plus twice the longest token.
+ */
+class ChunkedLexer {
+public:
+    /**
+     * @brief Constructor.
+     * @param context Compilation context passed on to the underlying Lexer.
+     */
+    explicit ChunkedLexer(CompilationContext& context) : lexer(std::string_view(), context) {}
+
+    /**
+     * @brief Lexes the next piece of the stream.
+     * @param chunk The bytes that follow the previous chunk. Only needs to live for the call.
+     * @param onToken Called with every token that is complete, INVALID ones included. Token
+     *                values are only valid during the call; Token::symbol ids remain valid and
+     *                Token::offset counts from the start of the stream.
+     */
+    template <class F>
+    void feed(std::string_view chunk, F&& onToken) {
+        if (carry.empty()) {
+            lex(chunk, onToken);
+            carry.assign(chunk.data() + lexer.position(), chunk.size() - lexer.position());
+            carryOffset += lexer.position();
+        } else {
+            carry.append(chunk.data(), chunk.size());
+            if (carry.size() < rescanSize) return;      // The cut-off token is still being collected
+            lex(carry, onToken);
+            carry.erase(0, lexer.position());
+            carryOffset += lexer.position();
+        }
+        rescanSize = 2 * carry.size();
+    }
+
+    /**
+     * @brief Ends the stream and emits the remaining tokens.
+     * @param onToken Called as in feed(). END is not passed on.
+     */
+    template <class F>
+    void finish(F&& onToken) {
+        lexer.resume(carry);
+        for (Token token = lexer.nextToken(); token.type != END; token = lexer.nextToken()) {
+            token.offset += carryOffset;
+            onToken(token);
+        }
+        carry.clear();
+        carryOffset = 0;
+        rescanSize = 0;
+    }
+
+    /**
+     * @brief Returns the symbol table built so far.
+     */
+    const SymbolTable& symbols() const { return lexer.symbols(); }
+
+private:
+    // Emits the complete tokens of a buffer, leaving the lexer at the first incomplete one
+    template <class F>
+    void lex(std::string_view buffer, F& onToken) {
+        lexer.resume(buffer);
+        Token token;
+        while (lexer.nextCompleteToken(token)) {
+            token.offset += carryOffset;
+            onToken(token);
+        }
+    }
+
+    Lexer lexer;                    ///< Lexes the current chunk or carry; owns the symbol table
+    std::string carry;              ///< Bytes of the token cut off by the end of the last chunk
+    size_t carryOffset = 0;         ///< Stream offset of the first byte of the carry (or next chunk)
+    size_t rescanSize = 0;          ///< Carry size at which the carry is lexed again
+};
+
+
+
+// Token types as the Parser reads them, without expanding a packed token
+inline TokenType tokenTypeAt(const std::vector<Token>& tokens, size_t index) { return tokens[index].type; }
+inline TokenType tokenTypeAt(const PackedTokenStream& tokens, size_t index) { return tokens.type(index); }
+
+// Parser class for parsing the tokens generated
+/**
+ * @class BasicParser
+ * @brief Syntactic analyzer that parses a sequence of tokens based on grammer rules specified
+ * 
+ * The Parser class takes a sequence of tokens generated by the Lexer and checks whether 
+ * they conform to the syntactic rules of the language. It builds an Abstract Syntax Tree (AST) 
+ * to represent the structure of the input, and handles errors if the input is not valid.
+ *
+ * @tparam Tokens The token sequence: std::vector<Token> (Parser) or PackedTokenStream
+ *                (PackedParser), which is read in place without expanding it to Tokens.
+ */
+template <class Tokens>
+class BasicParser {
+public:
+    //Constructor
+    /**
+     * @brief Constructor that initializes the Parser with a sequence of tokens.
+     * @param tokens The tokens produced by the Lexer. They are referenced, not copied, and
+     *               must outlive the Parser; they may be refilled between parses.
+     * @param context Compilation context holding the Lexer's errors; parse errors are added to it.
+     */
+    BasicParser(const Tokens& tokens, CompilationContext& context) : tokens(tokens), currentPos(0), context(context) {}
+
+    /**
+     * @brief Parses the input tokens to build an AST.
+     * 
+     * The parse() method begins by parsing the first token as a start word, then continues 
+     * parsing subsequent tokens based on the language's syntactic rules (handling words, commas, 
+     * hyphens, and punctuation). If the input is valid, it returns a pointer to the root of the AST.
+     * 
+     * @return const ASTNode* The root node of the AST, or nullptr if there are errors. The tree
+     *         is owned by the Parser and stays valid until the next parse() or its destruction.
+     */
+    const ASTNode* parse() {
+        reset();
+        arena.clear();
+        ArenaTreeBuilder builder{ arena };
+        return report(parseSentence(builder)) ? builder.root : nullptr;
+    }
+
+    /**
+     * @brief Parses the input tokens into the compact array layout.
+     * @param ast Receives the tree (node 0 is the Sentence). Its previous contents are replaced,
+     *            and it is left empty if there are errors.
+     * @return bool True if the input is a valid sentence.
+     */
+    bool parseFlat(FlatAst& ast) {
+        reset();
+        ast.clear();
+        FlatAstBuilder builder{ ast };
+        if (report(parseSentence(builder))) return true;
+        ast.clear();
+        return false;
+    }
+
+    /**
+     * @brief Checks whether the input tokens form a valid sentence without building anything.
+     *
+     * Runs the same grammar checks as parse(), but allocates nothing: no AST is built, no
+     * accepted tokens are recorded and no error message is formatted (hasErrors() stays false).
+     * Use describe() to turn a failure into the message parse() would report.
+     *
+     * @return ValidationResult The status and the index of the token where it was detected.
+     */
+    ValidationResult validate() {
+        reset();
+        NullBuilder builder;
+        return parseSentence(builder);
+    }
+
+    /**
+     * @brief Checks the input tokens and reports every syntax error instead of the first one.
+     *
+     * After an error the parser skips ahead to the next Word or Stop and carries on, so one
+     * pass finds every problem: a wrong first token, each pair of consecutive commas or
+     * hyphens (under the same comma rule as parse()), each misplaced Startword, a missing Stop
+     * and tokens after the Stop. The first diagnostic is the syntax error parse() would report.
+     * Nothing is built and no message is formatted.
+     *
+     * @param diagnostics Vector the diagnostics are appended to, in token order.
+     */
+    void diagnose(std::vector<Diagnostic>& diagnostics) {
+        COMPILER_TIME_PHASE(PHASE_PARSE);
+        const size_t count = tokens.size();
+        auto report = [&](ParseStatus status, size_t index) {
+            if (index < count) diagnostics.push_back({ status, static_cast<uint32_t>(index), tokens[index].offset, tokens[index].value });
+            else diagnostics.push_back({ status, static_cast<uint32_t>(count), endOffset(), std::string_view() });
+        };
+
+        size_t commasSeen = 0;              // Commas before index
+        size_t commasAhead = 0;             // Commas from the scan position to the Stop
+        size_t commasAtScan = 0;
+        bool scanned = false;
+
+        // Skips to the next Word or Stop, counting the commas passed
+        auto sync = [&](size_t index) {
+            for (; index < count && typeAt(index) != WORD && typeAt(index) != STOP; ++index) {
+                if (typeAt(index) == COMMA) commasSeen++;
+            }
+            return index;
+        };
+
+        size_t index = 1;
+        if (count == 0 || typeAt(0) != STARTWORD) {
+            report(PARSE_EXPECTED_STARTWORD, 0);
+            index = sync(0);
+        }
+
+        bool lastWasComma = false;
+        bool lastWasHyphen = false;
+        while (index < count && typeAt(index) != STOP) {
+            bool failed = false;
+            switch (typeAt(index)) {
+            case COMMA:
+                failed = lastWasComma;
+                if (failed) report(PARSE_CONSECUTIVE_COMMAS, index);
+                commasSeen++;
+                lastWasComma = true;
+                lastWasHyphen = false;
+                break;
+
+            case HYPHEN:
+                if (lastWasHyphen) {
+                    COMPILER_COUNT(COUNTER_HYPHEN_LOOKAHEADS, 1);
+                    if (!scanned) {
+                        size_t ahead = index;
+                        for (; ahead < count && typeAt(ahead) != STOP; ahead++) {
+                            if (typeAt(ahead) == COMMA) commasAhead++;
+                        }
+                        COMPILER_COUNT(COUNTER_HYPHEN_SCANNED_TOKENS, ahead - index);
+                        commasAtScan = commasSeen;
+                        scanned = true;
+                    }
+                    const size_t commasLeft = commasAhead - (commasSeen - commasAtScan);
+                    if (commasLeft >= 2) report(PARSE_CONSECUTIVE_COMMAS, index);
+                    else if (commasLeft == 0) report(PARSE_CONSECUTIVE_HYPHENS, index);
+                    failed = commasLeft != 1;
+                }
+                lastWasHyphen = true;
+                lastWasComma = false;
+                break;
+
+            case WORD:
+            case QUOTATION:
+                lastWasComma = false;
+                lastWasHyphen = false;
+                break;
+
+            default:
+                report(PARSE_UNEXPECTED_TOKEN, index);
+                failed = true;
+                break;
+            }
+
+            if (failed) {
+                index = sync(index + 1);
+                lastWasComma = false;
+                lastWasHyphen = false;
+            } else {
+                index++;
+            }
+        }
+
+        // As in parse(), a second Stop straight after the first is not reported
+        if (index >= count) {
+            report(PARSE_EXPECTED_STOP, count);
+        } else if (index + 1 < count && typeAt(index + 1) != STOP) {
+            report(PARSE_EXTRA_TOKENS, index + 1);
+        }
+    }
+
+    /**
+     * @brief Formats a validation result as the error message parse() would report.
+     * @param result A result returned by validate() on this Parser.
+     * @return std::string The message, or an empty string if the result is a success.
+     */
+    std::string describe(const ValidationResult& result) const {
+        std::string_view text = result.tokenIndex < tokens.size() ? tokens[result.tokenIndex].value : std::string_view();
+        return describeParseError(result.status, text);
+    }
+
+    /**
+     * @brief Checks if any errors were encountered during parsing.
+     * @return bool True if errors exist, false otherwise.
+     */
+    bool hasErrors() const { return !context.parseErrors.empty(); }
+
+    /**
+     * @brief Returns the outcome of the last parse() or parseFlat().
+     */
+    const ValidationResult& result() const { return lastResult; }
+
+    /**
+     * @brief Prints any errors encountered during the parsing process.
+     * @param out Where to print.
+     */
+    void printErrors(OutputSink& out = standardOutput()) const {
+        for (const Diagnostic& error : context.parseErrors) {
+            writeDiagnostic(out, error);
+            out << '\n';
+        }
+    }
+    
+    /**
+     * @brief Prints the accepted string formed during parsing (skipping quotations).
+     * @param out Where to print.
+     */
+    void printAcceptedString(OutputSink& out = standardOutput()) const {
+        for (size_t i = 0; i < acceptedTokens.size(); ++i) {
+            if (acceptedTokens[i].type != QUOTATION) {
+                out << acceptedTokens[i].value;
+                if (i != acceptedTokens.size() - 1 ) {
+                    out << " ";                         // Add space between tokens 
+                }
+            }
+        }
+        out << '\n';
+    }
+
+private:
+    const Tokens& tokens;               ///< The input tokens produced by the Lexer.
+    size_t currentPos;                  ///< Current position in the token list.
+    CompilationContext& context;        ///< Lexical errors and errors encountered during parsing.
+    std::vector<Token> acceptedTokens;  ///< List of accepted tokens that form the valid string.
+    AstArena arena;                     ///< Storage for the nodes of the AST.
+    ValidationResult lastResult = { PARSE_OK, NO_TOKEN };  ///< Outcome of the last parse() or parseFlat().
+
+    /**
+     * @brief Returns the type of a token, read straight from the token sequence.
+     */
+    TokenType typeAt(size_t index) const { return tokenTypeAt(tokens, index); }
+
+    /**
+     * @brief Returns the type of the current token, or END past the last one.
+     */
+    TokenType currentType() const { return currentPos < tokens.size() ? typeAt(currentPos) : END; }
+
+    /**
+     * @brief Rewinds to the first token and forgets the results of a previous parse.
+     */
+    void reset() {
+        currentPos = 0;
+        context.parseErrors.clear();
+        acceptedTokens.clear();
+    }
+
+    /**
+     * @brief Records the error message of a failed parse.
+     * @return bool True if the result is a success.
+     */
+    bool report(const ValidationResult& result) {
+        lastResult = result;
+        if (result.ok()) return true;
+        if (result.tokenIndex < tokens.size()) {
+            const Token& token = tokens[result.tokenIndex];
+            context.parseErrors.push_back({ result.status, result.tokenIndex, token.offset, token.value });
+        } else {
+            // Missing Stop or lexical errors
+            context.parseErrors.push_back({ result.status, result.tokenIndex, endOffset(), std::string_view() });
+        }
+        return false;
+    }
+
+    /**
+     * @brief Returns the offset errors at the end of the input are reported at: the end of
+     *        the last valid token, or 0 if there is none.
+     */
+    size_t endOffset() const {
+        if (tokens.empty()) return 0;
+        const Token& last = tokens.back();
+        return last.offset + last.value.size() + (last.type == QUOTATION ? 1 : 0);
+    }
+
+    /**
+     * @brief Advances to the next token.
+     */
+    void advanceToken() {
+        if (currentPos < tokens.size()) {
+            currentPos++;
+        }
+    }
+
+    /**
+     * @brief Parses a sentence according to the syntactic rules.
+     * 
+     * The parseSentence() method parses tokens as a valid sentence, ensuring that 
+     * the input starts with a Startword and ends with a Stop. It also handles commas, 
+     * hyphens, and quotations as per the defined grammar.
+     * 
+     * @tparam Builder Policy that creates the tree nodes (ArenaTreeBuilder, FlatAstBuilder or NullBuilder).
+     * @return ValidationResult PARSE_OK, or the first rule the tokens break and where.
+     */
+    template <class Builder>
+    ValidationResult parseSentence(Builder& builder) {
+    COMPILER_TIME_PHASE(PHASE_PARSE);
+    typename Builder::Node sentenceNode = builder.add(Builder::none, NODE_SENTENCE, NO_TOKEN);
+
+    if (parseStartword(builder, sentenceNode)) {
+        accept<Builder>();
+    } else {
+        return { PARSE_EXPECTED_STARTWORD, static_cast<uint32_t>(currentPos) };
+    }
+
+    bool lastWasComma = false;
+    bool lastWasHyphen = false;
+
+    // Commas between the current token and the Stop, counted once on first need
+    size_t commasSeen = 0;                          // Commas parsed so far
+    size_t commasAhead = 0;                         // Commas from the scan position to the Stop
+    size_t commasAtScan = 0;                        // commasSeen when the scan was made
+    bool scanned = false;
+
+    // Branch on the type of each token once; the switch compiles to a jump table
+    while (currentPos < tokens.size()) {
+        const TokenType type = typeAt(currentPos);
+        if (type == STOP) break;
+
+        switch (type) {
+        case COMMA:
+            if (lastWasComma) {
+                return { PARSE_CONSECUTIVE_COMMAS, static_cast<uint32_t>(currentPos) };
+            }
+            if (parseComma(builder, sentenceNode)) {
+                accept<Builder>();
+            }
+            commasSeen++;
+            lastWasComma = true;
+            lastWasHyphen = false;
+            break;
+
+        case HYPHEN:
+            if (lastWasHyphen) {
+
+                // Checking for commas in rest of the string: the tokens up to the Stop are
+                // scanned only the first time, later checks subtract the commas parsed since
+                COMPILER_COUNT(COUNTER_HYPHEN_LOOKAHEADS, 1);
+                if (!scanned) {
+                    size_t tempPos = currentPos;
+                    for (; tempPos < tokens.size() && typeAt(tempPos) != STOP; tempPos++) {
+                        if (typeAt(tempPos) == COMMA) commasAhead++;
+                    }
+                    COMPILER_COUNT(COUNTER_HYPHEN_SCANNED_TOKENS, tempPos - currentPos);
+                    commasAtScan = commasSeen;
+                    scanned = true;
+                }
+                const size_t commasLeft = commasAhead - (commasSeen - commasAtScan);
+
+                // Flags for tracking comma till end of string
+                bool commaFound = commasLeft >= 1;
+                bool commaError = commasLeft >= 2;
+
+                if (commaError) {
+                    return { PARSE_CONSECUTIVE_COMMAS, static_cast<uint32_t>(currentPos) };
+                } else if (!commaFound) {
+                    return { PARSE_CONSECUTIVE_HYPHENS, static_cast<uint32_t>(currentPos) };
+                }
+            }
+
+            if (parseHyphen(builder, sentenceNode)) {
+                accept<Builder>();
+            }
+            lastWasHyphen = true;
+            lastWasComma = false;
+            break;
+
+        case WORD:
+            if (parseWord(builder, sentenceNode)) {
+                accept<Builder>();
+            }
+            lastWasComma = false;
+            lastWasHyphen = false;
+            break;
+
+        case QUOTATION:
+            if (parseQuotation(builder, sentenceNode)) {
+                accept<Builder>();
+            }
+            lastWasComma = false;
+            lastWasHyphen = false;
+            break;
+
+        default:
+            return { PARSE_UNEXPECTED_TOKEN, static_cast<uint32_t>(currentPos) };
+        }
+    }
+
+    // Check if we encountered the STOP token
+    if (currentPos < tokens.size() && currentType() == STOP) {
+        if (parseStop(builder, sentenceNode)) {
+            accept<Builder>();
+            advanceToken();  // Move past the STOP token
+
+            // DEBUG: Confirm advancing after STOP
+            // std::cout << "Reached STOP token. Advancing token pointer.\n";
+        }
+    } else {
+        return { PARSE_EXPECTED_STOP, static_cast<uint32_t>(currentPos) };
+    }
+
+    // Check if any tokens remain after the STOP token
+    // (the token after the STOP is at currentPos - 1, or it is the STOP itself if nothing follows)
+    const TokenType afterStop = typeAt(currentPos - 1);
+    if (afterStop != STOP && afterStop != END) {
+        // std::cout << "Extra tokens detected after STOP: " << currentToken().value << "\n";  // Debugging info
+        return { PARSE_EXTRA_TOKENS, static_cast<uint32_t>(currentPos - 1) };
+    }
+
+    // Check for lexical errors
+    if (!context.lexicalErrors.empty()) {
+        return { PARSE_LEXICAL_ERRORS, NO_TOKEN };
+    }
+
+    return { PARSE_OK, NO_TOKEN };
+}
+
+
+    /**
+     * @brief Records the token just parsed as accepted, if the builder policy asks for it.
+     */
+    template <class Builder>
+    void accept() {
+        if constexpr (Builder::collectsTokens) {
+            acceptedTokens.push_back(tokens[currentPos - 1]);
+        }
+    }
+
+    /**
+     * @brief Parses a Startword token.
+     * @param builder Builder that creates the node.
+     * @param parent Node the Startword is added under.
+     * @return bool True if a Startword node was added, false if parsing fails.
+     */
+    template <class Builder>
+    bool parseStartword(Builder& builder, typename Builder::Node parent) {
+        if (currentType() == STARTWORD) {
+            builder.add(parent, NODE_STARTWORD, static_cast<uint32_t>(currentPos));
+            advanceToken();  // Move to the next token
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parses a Word token.
+     * @param builder Builder that creates the node.
+     * @param parent Node the Word is added under.
+     * @return bool True if a Word node was added, false if parsing fails.
+     */
+    template <class Builder>
+    bool parseWord(Builder& builder, typename Builder::Node parent) {
+        if (currentType() == WORD) {
+            builder.add(parent, NODE_WORD, static_cast<uint32_t>(currentPos));
+            advanceToken();  // Move to the next token
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parses a Comma token.
+     * @param builder Builder that creates the node.
+     * @param parent Node the Comma is added under.
+     * @return bool True if a Comma node was added, false if parsing fails.
+     */
+    template <class Builder>
+    bool parseComma(Builder& builder, typename Builder::Node parent) {
+        if (currentType() == COMMA) {
+            builder.add(parent, NODE_COMMA, static_cast<uint32_t>(currentPos));
+            advanceToken();  // Move to the next token
+            return true;
+        } else {
+            return false;
+        }
+    }
+    
+     /**
+     * @brief Parses a Hyphen token.
+     * @param builder Builder that creates the node.
+     * @param parent Node the Hyphen is added under.
+     * @return bool True if a Hyphen node was added, false if parsing fails.
+     */
+    template <class Builder>
+    bool parseHyphen(Builder& builder, typename Builder::Node parent) {
+        if (currentType() == HYPHEN) {
+            builder.add(parent, NODE_HYPHEN, static_cast<uint32_t>(currentPos));
+            advanceToken();  // Move to the next token
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parses a Quotation token.
+     * @param builder Builder that creates the node.
+     * @param parent Node the Quotation is added under.
+     * @return bool True if a Quotation node was added, false if parsing fails.
+     */
+    template <class Builder>
+    bool parseQuotation(Builder& builder, typename Builder::Node parent) {
+        if (currentType() == QUOTATION) {
+            builder.add(parent, NODE_QUOTATION, static_cast<uint32_t>(currentPos));
+            advanceToken();  // Move to the next token
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parses a Stop token.
+     * @param builder Builder that creates the node.
+     * @param parent Node the Stop is added under.
+     * @return bool True if a Stop node was added, false if parsing fails.
+     */
+    template <class Builder>
+    bool parseStop(Builder& builder, typename Builder::Node parent) {
+        if (currentType() == STOP) {
+            builder.add(parent, NODE_STOP, static_cast<uint32_t>(currentPos));
+            advanceToken();  // Move to the next token
+            return true;
+        } else {
+            return false;
+        }
+    }
+};
+
+using Parser = BasicParser<std::vector<Token>>;             ///< Parser over a Token vector
+using PackedParser = BasicParser<PackedTokenStream>;        ///< Parser over 8-byte packed tokens
+
+
+
+// Streaming validator fed directly by the Lexer
+/**
+ * @class StreamingValidator
+ * @brief Checks a sentence token by token as the Lexer produces them, in constant memory.
+ *
+ * It gives the same ValidationResult as Parser::validate() on the vector of valid tokens,
+ * but keeps only the grammar state (lastWasComma, lastWasHyphen and comma counters) instead
+ * of the token vector. Invalid tokens are skipped and counted as lexical errors, as main()
+ * does, and token indices count only the valid tokens.
+ *
+ * Parser looks ahead from a second consecutive hyphen to count the commas up to the Stop.
+ * That cannot be done on a stream, so the check is deferred: the comma count before the
+ * first such hyphen is remembered and the outcome is settled once the Stop (or the end of
+ * input) arrives, together with any later error that might or might not win over it.
+ */
+class StreamingValidator {
+public:
+    /**
+     * @brief Feeds the next token.
+     * @param token A token from Lexer::nextToken() (END tokens are ignored; call finish()).
+     */
+    void push(const Token& token) {
+        if (token.type == END) return;
+        if (token.type == INVALID) {
+            sawInvalid = true;
+            return;
+        }
+        const uint32_t index = tokenCount++;
+
+        switch (phase) {
+            case EXPECT_STARTWORD:
+                if (token.type == STARTWORD) phase = IN_SENTENCE;
+                else decide(PARSE_EXPECTED_STARTWORD, index, token.value);
+                break;
+
+            case IN_SENTENCE:
+                if (token.type == STOP) {
+                    if (resolveHyphenCheck()) phase = AFTER_STOP;
+                    break;
+                }
+                if (token.type == COMMA) {
+                    if (pendingError == PARSE_OK && lastWasComma) fail(PARSE_CONSECUTIVE_COMMAS, index, token.value);
+                    commas++;
+                    lastWasComma = true;
+                    lastWasHyphen = false;
+                } else if (token.type == HYPHEN) {
+                    if (lastWasHyphen) checkConsecutiveHyphen(index);
+                    lastWasHyphen = true;
+                    lastWasComma = false;
+                } else if (token.type == WORD || token.type == QUOTATION) {
+                    lastWasComma = false;
+                    lastWasHyphen = false;
+                } else if (pendingError == PARSE_OK) {
+                    fail(PARSE_UNEXPECTED_TOKEN, index, token.value);
+                }
+                break;
+
+            case AFTER_STOP:
+                // Only the token right after the Stop is checked
+                if (token.type != STOP) decide(PARSE_EXTRA_TOKENS, index, token.value);
+                else phase = SCAN_LEXICAL;
+                break;
+
+            case SCAN_LEXICAL:
+            case DECIDED:
+                break;
+        }
+    }
+
+    /**
+     * @brief Signals the end of the input.
+     * @return ValidationResult The outcome for everything pushed so far.
+     */
+    ValidationResult finish() {
+        switch (phase) {
+            case EXPECT_STARTWORD:
+                decide(PARSE_EXPECTED_STARTWORD, 0, std::string_view());
+                break;
+            case IN_SENTENCE:
+                if (resolveHyphenCheck()) decide(PARSE_EXPECTED_STOP, tokenCount, std::string_view());
+                break;
+            case AFTER_STOP:
+            case SCAN_LEXICAL:
+                if (sawInvalid) decide(PARSE_LEXICAL_ERRORS, NO_TOKEN, std::string_view());
+                else decide(PARSE_OK, NO_TOKEN, std::string_view());
+                break;
+            case DECIDED:
+                break;
+        }
+        return result;
+    }
+
+    /**
+     * @brief Checks whether the outcome is known regardless of the remaining tokens.
+     *
+     * Once a syntax error is settled, the rest of the input cannot change the result and the
+     * caller may stop lexing.
+     */
+    bool decided() const { return phase == DECIDED; }
+
+    /**
+     * @brief Formats a result of this validator as the error message Parser::parse() would report.
+     * @param result The value returned by finish(). The quoted token text is a view into the
+     *               Lexer input, so the input must still be alive.
+     */
+    std::string describe(const ValidationResult& result) const {
+        return describeParseError(result.status, errorText);
+    }
+
+    /**
+     * @brief Validates everything a Lexer produces, pulling tokens until the end of the input
+     *        or until the outcome is decided.
+     * @param lexer The Lexer to read from. Turn its interning off (Lexer::setInterning) to keep
+     *              the whole pass in constant memory.
+     * @return ValidationResult The outcome for the Lexer's input.
+     */
+    ValidationResult run(Lexer& lexer) {
+        COMPILER_TIME_PHASE(PHASE_STREAM);
+        for (Token token = lexer.nextToken(); token.type != END && !decided(); token = lexer.nextToken()) {
+            push(token);
+        }
+        return finish();
+    }
+
+private:
+    enum Phase : unsigned char { EXPECT_STARTWORD, IN_SENTENCE, AFTER_STOP, SCAN_LEXICAL, DECIDED };
+
+    Phase phase = EXPECT_STARTWORD;
+    bool lastWasComma = false;
+    bool lastWasHyphen = false;
+    bool sawInvalid = false;                    ///< An invalid token was skipped
+    uint32_t tokenCount = 0;                    ///< Valid tokens seen so far
+    uint32_t commas = 0;                        ///< Commas seen before the Stop
+
+    // Deferred consecutive-hyphen check
+    uint32_t hyphenCheckIndex = NO_TOKEN;       ///< First hyphen that followed a hyphen
+    uint32_t commasBeforeCheck = 0;             ///< Commas seen before that hyphen
+    uint32_t laterCheckIndex = NO_TOKEN;        ///< First such hyphen after a further comma
+
+    // First error after the check, which only stands if the check passes
+    ParseStatus pendingError = PARSE_OK;
+    uint32_t pendingIndex = NO_TOKEN;
+    std::string_view pendingText;
+
+    ValidationResult result = { PARSE_OK, NO_TOKEN };
+    std::string_view errorText;                 ///< Text of the token quoted by the result
+
+    /**
+     * @brief Settles the outcome.
+     */
+    void decide(ParseStatus status, uint32_t index, std::string_view text) {
+        result = { status, index };
+        errorText = text;
+        phase = DECIDED;
+    }
+
+    /**
+     * @brief Records a syntax error inside the sentence. It is final unless a deferred
+     *        hyphen check comes before it, in which case it stays pending until the Stop.
+     */
+    void fail(ParseStatus status, uint32_t index, std::string_view text) {
+        if (hyphenCheckIndex == NO_TOKEN) {
+            decide(status, index, text);
+            return;
+        }
+        pendingError = status;
+        pendingIndex = index;
+        pendingText = text;
+    }
+
+    /**
+     * @brief Handles a hyphen that directly follows another hyphen.
+     *
+     * The first one opens the deferred check. A later one matters only if a comma came in
+     * between: if the first check passes (exactly one comma up to the Stop), that comma is
+     * behind the later hyphen, which therefore has none left and fails.
+     */
+    void checkConsecutiveHyphen(uint32_t index) {
+        if (hyphenCheckIndex == NO_TOKEN) {
+            hyphenCheckIndex = index;
+            commasBeforeCheck = commas;
+        } else if (laterCheckIndex == NO_TOKEN && pendingError == PARSE_OK && commas > commasBeforeCheck) {
+            laterCheckIndex = index;
+        }
+    }
+
+    /**
+     * @brief Settles the deferred hyphen check at the Stop or the end of input.
+     * @return bool True if the sentence is still valid so far.
+     */
+    bool resolveHyphenCheck() {
+        if (hyphenCheckIndex != NO_TOKEN) {
+            const uint32_t commasAfter = commas - commasBeforeCheck;
+            if (commasAfter >= 2) decide(PARSE_CONSECUTIVE_COMMAS, hyphenCheckIndex, std::string_view());
+            else if (commasAfter == 0) decide(PARSE_CONSECUTIVE_HYPHENS, hyphenCheckIndex, std::string_view());
+            else if (laterCheckIndex != NO_TOKEN) decide(PARSE_CONSECUTIVE_HYPHENS, laterCheckIndex, std::string_view());
+        }
+        if (phase != DECIDED && pendingError != PARSE_OK) {
+            decide(pendingError, pendingIndex, pendingText);
+        }
+        return phase != DECIDED;
+    }
+};
+
+
+
+// Byte-level screening before lexing
+/**
+ * @enum ScreenFlag
+ * @brief Kinds of byte found by screenBytes(), as bits of a mask.
+ */
+enum ScreenFlag : uint32_t {
+    SCREEN_UPPER  = 1u << 0,    ///< An upper-case letter
+    SCREEN_COMMA  = 1u << 1,
+    SCREEN_HYPHEN = 1u << 2,
+    SCREEN_STOP   = 1u << 3,
+    SCREEN_QUOTE  = 1u << 4,
+    SCREEN_OTHER  = 1u << 5,    ///< Not a letter, whitespace or punctuation (a digit, say); always part of an invalid token
+};
+
+/**
+ * @brief Returns the ScreenFlag of one byte, or 0 for whitespace and lower-case letters.
+ */
+inline uint32_t screenFlag(char c) {
+    switch (charClass(c)) {
+        case CC_UPPER: return SCREEN_UPPER;
+        case CC_COMMA: return SCREEN_COMMA;
+        case CC_HYPHEN: return SCREEN_HYPHEN;
+        case CC_STOP: return SCREEN_STOP;
+        case CC_QUOTE: return SCREEN_QUOTE;
+        case CC_OTHER: return SCREEN_OTHER;
+        default: return 0;
+    }
+}
+
+/**
+ * @brief Finds which kinds of byte occur in [pos, end) in one pass.
+ * @param stopAt Flags after which the rest of the range does not matter.
+ * @return uint32_t The ScreenFlag bits of every byte in the range, or-ed together. If one of
+ *         @p stopAt is included, the scan may have ended early and other bits may be missing.
+ */
+inline uint32_t screenBytes(const char* data, size_t pos, size_t end, uint32_t stopAt = 0) {
+    uint32_t flags = 0;
+#ifdef LEXER_HAVE_SSE2
+    // Accumulate one lane mask per kind and test them every 64 bytes
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    __m128i upper = _mm_setzero_si128(), comma = upper, hyphen = upper, stop = upper, quote = upper, other = upper;
+    for (size_t block = 1; pos + 16 <= end; ++block) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const __m128i letters = letterMask16(v);
+        const __m128i isComma = _mm_cmpeq_epi8(v, _mm_set1_epi8(','));
+        const __m128i isHyphen = _mm_cmpeq_epi8(v, _mm_set1_epi8('-'));
+        const __m128i isStop = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+        const __m128i isQuote = _mm_cmpeq_epi8(v, _mm_set1_epi8('\''));
+        const __m128i known = _mm_or_si128(_mm_or_si128(letters, spaceMask16(v)),
+                              _mm_or_si128(_mm_or_si128(isComma, isHyphen), _mm_or_si128(isStop, isQuote)));
+        upper = _mm_or_si128(upper, _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(v, caseBit), caseBit), letters));
+        comma = _mm_or_si128(comma, isComma);
+        hyphen = _mm_or_si128(hyphen, isHyphen);
+        stop = _mm_or_si128(stop, isStop);
+        quote = _mm_or_si128(quote, isQuote);
+        other = _mm_or_si128(other, _mm_xor_si128(known, _mm_set1_epi8(-1)));
+        pos += 16;
+
+        if (stopAt && (block & 3) == 0) {
+            if (_mm_movemask_epi8(upper)) flags |= SCREEN_UPPER;
+            if (_mm_movemask_epi8(comma)) flags |= SCREEN_COMMA;
+            if (_mm_movemask_epi8(hyphen)) flags |= SCREEN_HYPHEN;
+            if (_mm_movemask_epi8(quote)) flags |= SCREEN_QUOTE;
+            if (flags & stopAt) break;
+        }
+    }
+    if (_mm_movemask_epi8(upper)) flags |= SCREEN_UPPER;
+    if (_mm_movemask_epi8(comma)) flags |= SCREEN_COMMA;
+    if (_mm_movemask_epi8(hyphen)) flags |= SCREEN_HYPHEN;
+    if (_mm_movemask_epi8(stop)) flags |= SCREEN_STOP;
+    if (_mm_movemask_epi8(quote)) flags |= SCREEN_QUOTE;
+    if (_mm_movemask_epi8(other)) flags |= SCREEN_OTHER;
+    if (flags & stopAt) return flags;
+#endif
+    for (; pos < end && !(flags & stopAt); ++pos) flags |= screenFlag(data[pos]);
+    return flags;
+}
+
+/**
+ * @brief Counts the valid tokens of text made only of letters, whitespace and SCREEN_OTHER bytes.
+ */
+inline size_t countPlainTokens(const char* data, size_t pos, size_t end) {
+    size_t count = 0;
+    while (pos < end) {
+        if (isSpaceChar(data[pos])) {
+            pos++;
+            continue;
+        }
+        const size_t start = pos;
+        while (pos < end && isLetterChar(data[pos])) pos++;
+        if (pos > start) {
+            // A run of over 26 letters is cut into 26-letter words and a last piece
+            const size_t pieces = (pos - start - 1) / 26;
+            count += pieces + (pos - start - 26 * pieces >= 3 ? 1 : 0);
+        }
+        // Whatever follows up to the next whitespace is one invalid token
+        while (pos < end && !isSpaceChar(data[pos])) pos++;
+    }
+    return count;
+}
+
+/**
+ * @brief Decides an input from its bytes alone, without lexing, when that is certain to give
+ *        the same result as lexing and parsing it.
+ * @param input The input text.
+ * @param result Receives the result, as Parser::validate() would report it.
+ * @param errorText Receives the token text quoted by the error message, if it quotes one.
+ * @return bool True if the input was decided; false means it has to be lexed and parsed.
+ *
+ * Only rejections are decided, and only where they are exact:
+ * - The first token is valid but not a Startword. This looks at the first token only.
+ * - The Startword is followed by nothing but lower-case words, whitespace and invalid bytes.
+ *   With no Stop, that is a missing Stop. If a word follows the first Stop, that is extra
+ *   tokens. If only whitespace follows it and some byte is invalid, that is lexical errors.
+ *
+ * Anything else is left to the Parser: commas, hyphens, quotations, later Startwords, a second
+ * Stop straight after the first, or inputs that may be valid.
+ */
+inline bool screenInput(std::string_view input, ValidationResult& result, std::string_view& errorText) {
+    const char* data = input.data();
+    const size_t length = input.size();
+    size_t pos = 0;
+    while (pos < length && isSpaceChar(data[pos])) pos++;
+
+    // The first token
+    errorText = std::string_view();
+    result = { PARSE_EXPECTED_STARTWORD, 0 };
+    if (pos == length) return true;
+
+    const CharClass first = charClass(data[pos]);
+    if (first == CC_COMMA || first == CC_HYPHEN || first == CC_STOP) {
+        errorText = input.substr(pos, 1);
+        return true;
+    }
+    if (first == CC_QUOTE) {
+        const void* close = std::memchr(data + pos + 1, '\'', length - pos - 1);
+        const size_t end = close ? static_cast<const char*>(close) - data : length;
+        errorText = input.substr(pos + 1, end - pos - 1);
+        return true;
+    }
+    if (first == CC_OTHER) return false;                    // An invalid token: the first valid one comes later
+
+    const size_t wordEnd = scanKernels().skipLetters(data, pos, std::min(length, pos + 27));
+    if (wordEnd - pos < 3) return false;
+    if (wordEnd - pos > 26 || first == CC_LOWER) {
+        errorText = input.substr(pos, std::min<size_t>(wordEnd - pos, 26));
+        return true;
+    }
+
+    // A Startword: the rest is only decided if it holds nothing the Parser could stop at earlier
+    const uint32_t undecided = SCREEN_UPPER | SCREEN_COMMA | SCREEN_HYPHEN | SCREEN_QUOTE;
+    const uint32_t flags = screenBytes(data, wordEnd, length, undecided);
+    if (flags & undecided) return false;
+
+    if (!(flags & SCREEN_STOP)) {
+        result = { PARSE_EXPECTED_STOP, static_cast<uint32_t>(1 + countPlainTokens(data, wordEnd, length)) };
+        return true;
+    }
+
+    const size_t stop = static_cast<const char*>(std::memchr(data + wordEnd, '.', length - wordEnd)) - data;
+    size_t after = stop + 1;
+    while (after < length && isSpaceChar(data[after])) after++;
+    if (after == length) {
+        if (!(flags & SCREEN_OTHER)) return false;          // Valid, or only short words are invalid
+        result = { PARSE_LEXICAL_ERRORS, NO_TOKEN };
+        return true;
+    }
+    if (scanKernels().skipLetters(data, after, std::min(length, after + 3)) - after == 3) {
+        const size_t stopIndex = 1 + countPlainTokens(data, wordEnd, stop);
+        result = { PARSE_EXTRA_TOKENS, static_cast<uint32_t>(stopIndex + 1) };
+        return true;
+    }
+    return false;
+}
+
+
+
+// Reusable compiler state for serving many requests
+/**
+ * @class CompilerSession
+ * @brief Lexer, token buffer, Parser and diagnostics kept alive across compilations.
+ *
+ * Every compile() or validate() resets the previous results but keeps their storage: the
+ * token buffer, symbol table, error lists and AST arena only grow, so once a session has seen
+ * inputs of a similar size it compiles valid input without touching the allocator. A session
+ * is not thread-safe; use one per thread.
+ */
+class CompilerSession {
+public:
+    CompilerSession() : lexer(std::string_view(), compileContext), parser(tokenBuffer, compileContext) {}
+
+    CompilerSession(const CompilerSession&) = delete;
+    CompilerSession& operator=(const CompilerSession&) = delete;
+
+    /**
+     * @brief Lexes and parses an input into an AST.
+     * @param input The input text. It is borrowed and must stay alive while the results are used.
+     * @return bool True if the input is a valid sentence.
+     */
+    bool compile(std::string_view input) {
+        reset();
+        lexer.reset(input);
+        lexer.tokenizeAll(tokenBuffer);
+        astRoot = parser.parse();
+        return astRoot != nullptr;
+    }
+
+    /**
+     * @brief Lexes and parses an input into the compact array layout.
+     * @param input The input text. It is borrowed and must stay alive while the results are used.
+     * @param ast Receives the tree, or is left empty if the input is invalid.
+     * @return ValidationResult The outcome; the error record is in context().parseErrors.
+     */
+    ValidationResult compileFlat(std::string_view input, FlatAst& ast) {
+        reset();
+        lexer.reset(input);
+        lexer.tokenizeAll(tokenBuffer);
+        parser.parseFlat(ast);
+        return parser.result();
+    }
+
+    /**
+     * @brief Checks an input without building tokens or an AST (see StreamingValidator).
+     * @param input The input text. It is borrowed and must stay alive while describe() is used.
+     * @return ValidationResult The outcome, as Parser::validate() would report it.
+     *
+     * Inputs that screenInput() can reject from their bytes are not lexed at all. Words are
+     * not interned, so validating keeps no per-word state and symbols() stays empty.
+     */
+    ValidationResult validate(std::string_view input) {
+        reset();
+        lexer.setInterning(false);
+        lexer.reset(input);
+        ValidationResult result;
+        screened = screenInput(input, result, screenedText);
+        if (screened) return result;
+        validator = StreamingValidator();
+        return validator.run(lexer);
+    }
+
+    /**
+     * @brief Lexes and checks an input, reporting every lexical and syntax error in one pass.
+     * @param input The input text. It is borrowed by the diagnostics.
+     * @param diagnostics Receives the diagnostics ordered by offset (existing contents are replaced).
+     * @return size_t The number of diagnostics; 0 means the input is valid.
+     *
+     * Invalid tokens are reported one by one as PARSE_INVALID_TOKEN, and the valid tokens
+     * go through Parser::diagnose().
+     */
+    size_t diagnose(std::string_view input, std::vector<Diagnostic>& diagnostics) {
+        reset();
+        lexer.reset(input);
+        diagnostics.clear();
+        {
+            COMPILER_TIME_PHASE(PHASE_LEX);
+            for (Token token = lexer.nextToken(); token.type != END; token = lexer.nextToken()) {
+                if (token.type == INVALID) {
+                    diagnostics.push_back({ PARSE_INVALID_TOKEN, NO_TOKEN, token.offset, token.value });
+                } else {
+                    tokenBuffer.push_back(token);
+                }
+            }
+        }
+
+        syntaxDiagnostics.clear();
+        parser.diagnose(syntaxDiagnostics);
+
+        // Merge the two sorted lists from the back, so no temporary buffer is needed; at equal
+        // offsets the lexical diagnostic comes first
+        size_t lexical = diagnostics.size();
+        size_t syntax = syntaxDiagnostics.size();
+        diagnostics.resize(lexical + syntax);
+        for (size_t out = lexical + syntax; syntax > 0; ) {
+            if (lexical > 0 && syntaxDiagnostics[syntax - 1].offset < diagnostics[lexical - 1].offset) {
+                diagnostics[--out] = diagnostics[--lexical];
+            } else {
+                diagnostics[--out] = syntaxDiagnostics[--syntax];
+            }
+        }
+        return diagnostics.size();
+    }
+
+    /**
+     * @brief Formats the result of the last validate() as the Parser's error message.
+     */
+    std::string describe(const ValidationResult& result) const {
+        return screened ? describeParseError(result.status, screenedText) : validator.describe(result);
+    }
+
+    /**
+     * @brief Drops the results of the previous compilation, keeping the allocated storage.
+     */
+    void reset() {
+        compileContext.reset();
+        lexer.setInterning(true);
+        tokenBuffer.clear();
+        astRoot = nullptr;
+    }
+
+    const std::vector<Token>& tokens() const { return tokenBuffer; }           ///< Valid tokens of the last compile()
+    const CompilationContext& context() const { return compileContext; }      ///< Errors of the last call
+    const SymbolTable& symbols() const { return lexer.symbols(); }            ///< Symbols of the last call
+    const ASTNode* ast() const { return astRoot; }                            ///< Tree of the last compile(), or nullptr
+    const Parser& getParser() const { return parser; }                        ///< Parser of the last compile()
+
+private:
+    CompilationContext compileContext;
+    Lexer lexer;
+    std::vector<Token> tokenBuffer;
+    Parser parser;
+    StreamingValidator validator;
+    std::vector<Diagnostic> syntaxDiagnostics;  ///< Parser diagnostics of the last diagnose(), before merging
+    bool screened = false;                      ///< The last validate() was decided by screenInput()
+    std::string_view screenedText;              ///< Token text of that result
+    const ASTNode* astRoot = nullptr;
+};
+
+
+
+// Cache of compilation results for repeated inputs
+/**
+ * @class ParseCache
+ * @brief Bounded LRU cache of compilation results, keyed by the input bytes.
+ *
+ * Repeated inputs are answered from the cache without lexing or parsing. Keys are hashed with
+ * hashWords() and compared byte for byte, so hash collisions never return a wrong result.
+ * When the cache is full the least recently used entry is recycled for the new input.
+ */
+class ParseCache {
+public:
+    /**
+     * @struct Entry
+     * @brief Cached outcome of one input.
+     */
+    struct Entry {
+        std::string text;                           ///< The input; tokens point into it
+        ValidationResult result;                    ///< Outcome as Parser::parse() reports it
+        std::vector<Diagnostic> lexicalErrors;      ///< Texts point into text
+        std::vector<Diagnostic> parseErrors;
+        std::vector<Token> tokens;                  ///< Valid tokens, if ASTs are kept
+        FlatAst ast;                                ///< Tree, if ASTs are kept and the input is valid
+    };
+
+    /**
+     * @brief Constructor.
+     * @param capacity Maximum number of entries (at least one is kept).
+     * @param keepAst Also store the tokens and compact AST of each input.
+     */
+    explicit ParseCache(size_t capacity, bool keepAst = false) : maxEntries(std::max<size_t>(capacity, 1)), keepAst(keepAst) {
+        index.reserve(maxEntries);
+    }
+
+    ParseCache(const ParseCache&) = delete;
+    ParseCache& operator=(const ParseCache&) = delete;
+
+    /**
+     * @brief Returns the cached result of an input, compiling it on a miss.
+     * @param input The input text.
+     * @return const Entry& The result, valid until the next compile() or clear().
+     */
+    const Entry& compile(std::string_view input) {
+        const auto found = index.find(input);
+        if (found != index.end()) {
+            hitCount++;
+            entries.splice(entries.begin(), entries, found->second);
+            return *found->second;
+        }
+        missCount++;
+
+        // Recycle the least recently used entry once the cache is full
+        if (entries.size() == maxEntries) {
+            index.erase(entries.back().text);
+            entries.splice(entries.begin(), entries, std::prev(entries.end()));
+        } else {
+            entries.emplace_front();
+        }
+        Entry& entry = entries.front();
+        entry.text.assign(input.data(), input.size());
+        entry.result = session.compileFlat(entry.text, keepAst ? entry.ast : scratchAst);
+        entry.lexicalErrors = session.context().lexicalErrors;
+        entry.parseErrors = session.context().parseErrors;
+        if (keepAst) entry.tokens = session.tokens();
+        index.emplace(entry.text, entries.begin());
+        return entry;
+    }
+
+    /**
+     * @brief Drops every entry and resets the counters.
+     */
+    void clear() {
+        index.clear();
+        entries.clear();
+        hitCount = 0;
+        missCount = 0;
+    }
+
+    size_t size() const { return entries.size(); }      ///< Number of cached inputs
+    size_t capacity() const { return maxEntries; }      ///< Maximum number of cached inputs
+    uint64_t hits() const { return hitCount; }          ///< Lookups answered from the cache
+    uint64_t misses() const { return missCount; }       ///< Lookups that had to compile
+
+private:
+    struct KeyHash {
+        size_t operator()(std::string_view key) const { return static_cast<size_t>(hashWords(key)); }
+    };
+
+    size_t maxEntries;                  ///< Capacity
+    bool keepAst;                       ///< Store tokens and ASTs along with the results
+    std::list<Entry> entries;           ///< Entries, most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator, KeyHash> index;   ///< Keys point into Entry::text
+    CompilerSession session;            ///< Compiles the misses
+    FlatAst scratchAst;                 ///< Target of compileFlat() when ASTs are not kept
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+
+
+// Thread pool for data-parallel work
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads that run parallel loops.
+ *
+ * parallelFor() splits the index space evenly between the workers. Each worker takes small
+ * steps from the front of its own range and, once that is empty, steals the back half of
+ * another worker's range, so the only shared writes are the occasional steals. The calling
+ * thread takes part as worker 0. One loop runs at a time.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Starts the workers.
+     * @param threads Total number of threads including the caller, or 0 for one per hardware thread.
+     */
+    explicit ThreadPool(size_t threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        ranges = std::make_unique<WorkRange[]>(threads);
+        for (size_t worker = 1; worker < threads; ++worker) {
+            workers.emplace_back([this, worker] { workerLoop(worker); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : workers) thread.join();
+    }
+
+    /**
+     * @brief Returns the number of threads that run loop bodies, including the caller.
+     */
+    size_t size() const { return workers.size() + 1; }
+
+    /**
+     * @brief Calls fn(worker, index) for every index in [0, count) and waits for all calls.
+     * @param count Number of iterations.
+     * @param fn Loop body; worker is in [0, size()) and no two concurrent calls share one.
+     * @param grain Number of consecutive indices taken per step.
+     */
+    template <class F>
+    void parallelFor(size_t count, F&& fn, size_t grain = 16) {
+        grain = std::max<size_t>(grain, 1);
+        // Ranges are packed as two 32-bit bounds, so huge loops run as several rounds
+        for (size_t base = 0; base < count; base += MAX_ROUND) {
+            const size_t length = std::min(count - base, MAX_ROUND);
+            const std::function<void(size_t)> body = [&](size_t worker) {
+                uint32_t begin, end;
+                while (takeWork(worker, grain, begin, end)) {
+                    for (size_t index = base + begin; index < base + end; ++index) fn(worker, index);
+                }
+            };
+            runRound(length, body);
+        }
+    }
+
+private:
+    static constexpr size_t MAX_ROUND = 0xFFFFFFFFu;    ///< Most indices handed out per round
+
+    /**
+     * @struct WorkRange
+     * @brief Indices [begin, end) left to a worker, packed as begin << 32 | end, on its own
+     *        cache line. The owner advances begin; thieves lower end.
+     */
+    struct alignas(64) WorkRange {
+        std::atomic<uint64_t> packed{ 0 };
+    };
+
+    static uint64_t packRange(uint64_t begin, uint64_t end) { return begin << 32 | end; }
+
+    // Splits [0, count) between the workers and runs body on each of them
+    void runRound(size_t count, const std::function<void(size_t)>& body) {
+        const size_t threads = size();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t worker = 0; worker < threads; ++worker) {
+                ranges[worker].packed.store(packRange(count * worker / threads, count * (worker + 1) / threads), std::memory_order_relaxed);
+            }
+            job = &body;
+            busy = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        body(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+    }
+
+    // Takes up to grain indices from the worker's own range, stealing when it is empty
+    bool takeWork(size_t worker, size_t grain, uint32_t& begin, uint32_t& end) {
+        std::atomic<uint64_t>& own = ranges[worker].packed;
+        for (;;) {
+            uint64_t current = own.load(std::memory_order_acquire);
+            for (;;) {
+                const uint32_t first = static_cast<uint32_t>(current >> 32);
+                const uint32_t last = static_cast<uint32_t>(current);
+                if (first >= last) break;
+                const uint32_t next = static_cast<uint32_t>(std::min<uint64_t>(last, first + uint64_t(grain)));
+                if (own.compare_exchange_weak(current, packRange(next, last), std::memory_order_acq_rel)) {
+                    begin = first;
+                    end = next;
+                    return true;
+                }
+            }
+            if (!steal(worker)) return false;
+        }
+    }
+
+    // Moves the back half of another worker's range into the thief's (empty) range
+    bool steal(size_t thief) {
+        const size_t threads = size();
+        for (size_t step = 1; step < threads; ++step) {
+            std::atomic<uint64_t>& victim = ranges[(thief + step) % threads].packed;
+            uint64_t current = victim.load(std::memory_order_acquire);
+            for (;;) {
+                const uint32_t first = static_cast<uint32_t>(current >> 32);
+                const uint32_t last = static_cast<uint32_t>(current);
+                if (first >= last) break;
+                const uint32_t middle = first + (last - first) / 2;
+                if (victim.compare_exchange_weak(current, packRange(first, middle), std::memory_order_acq_rel)) {
+                    ranges[thief].packed.store(packRange(middle, last), std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<WorkRange[]> ranges;                ///< Range of each worker, worker 0 first
+    std::mutex mutex;
+    std::condition_variable wake;                       ///< Signals a new loop or shutdown
+    std::condition_variable done;                       ///< Signals that every worker finished the loop
+    const std::function<void(size_t)>* job = nullptr;   ///< Body of the running loop
+    size_t generation = 0;                              ///< Number of loops started
+    size_t busy = 0;                                    ///< Workers still inside the running loop
+    bool stopping = false;
+
+    void workerLoop(size_t worker) {
+        size_t seen = 0;
+        for (;;) {
+            const std::function<void(size_t)>* current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                current = job;
+            }
+            (*current)(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy == 0) done.notify_one();
+            }
+        }
+    }
+};
+
+
+
+// Document mode: many sentences validated independently
+/**
+ * @struct SentenceResult
+ * @brief Outcome of one sentence of a document.
+ */
+struct SentenceResult {
+    size_t offset;                  ///< Byte offset of the sentence in the document
+    size_t length;                  ///< Byte length, up to and including its Stop
+    ValidationResult result;        ///< Status, with token indices relative to the sentence
+    std::string message;            ///< Error message as Parser would report it, empty if valid
+};
+
+/**
+ * @brief Finds where the sentence starting at a given offset ends.
+ *
+ * A sentence ends after the next full stop the Lexer would emit as a STOP token, that is the
+ * next '.' outside a quotation. Whatever follows the last Stop counts as a final sentence
+ * unless it is only whitespace. Quotations open only where a token starts, so an apostrophe
+ * inside an invalid run does not start one.
+ *
+ * @param document The document text.
+ * @param begin Offset where the sentence starts: 0 or the end of the previous sentence.
+ * @return size_t The end offset (exclusive) of the sentence, or std::string_view::npos if only
+ *         whitespace is left.
+ */
+size_t findSentenceEnd(std::string_view document, size_t begin) {
+    const char* data = document.data();
+    const size_t length = document.length();
+    bool inInvalidRun = false;
+    bool pendingText = false;                       // Non-space bytes since begin
+
+    for (size_t i = begin; i < length; ++i) {
+        const CharClass cls = charClass(data[i]);
+        if (inInvalidRun) {
+            if (cls != CC_SPACE && cls != CC_COMMA && cls != CC_HYPHEN && cls != CC_STOP) continue;
+            inInvalidRun = false;
+        }
+        if (cls == CC_STOP) {
+            return i + 1;
+        } else if (cls == CC_QUOTE) {
+            const void* close = std::memchr(data + i + 1, '\'', length - i - 1);
+            i = close ? static_cast<const char*>(close) - data : length;
+            pendingText = true;
+        } else if (cls != CC_SPACE) {
+            inInvalidRun = cls == CC_OTHER;
+            pendingText = true;
+        }
+    }
+    return pendingText ? length : std::string_view::npos;
+}
+
+/**
+ * @brief Finds where each sentence of a document ends (see findSentenceEnd()).
+ * @param document The document text.
+ * @return std::vector<size_t> The end offset (exclusive) of each sentence, in order.
+ */
+std::vector<size_t> findSentenceEnds(std::string_view document) {
+    std::vector<size_t> ends;
+    for (size_t end = findSentenceEnd(document, 0); end != std::string_view::npos; end = findSentenceEnd(document, end)) {
+        ends.push_back(end);
+    }
+    return ends;
+}
+
+/**
+ * @brief Lexes and validates one sentence in constant memory.
+ * @param sentence The sentence text.
+ * @param offset Offset of the sentence in its document, copied into the result.
+ * @param session Session whose storage is reused for the sentence.
+ * @return SentenceResult The outcome of the sentence.
+ */
+SentenceResult validateSentence(std::string_view sentence, size_t offset, CompilerSession& session) {
+    SentenceResult result{ offset, sentence.length(), session.validate(sentence), std::string() };
+    if (!result.result.ok()) result.message = session.describe(result.result);
+    return result;
+}
+
+/**
+ * @brief Splits a document into sentences and validates them in parallel.
+ * @param document The document text.
+ * @param pool Threads to spread the sentences over.
+ * @return std::vector<SentenceResult> One result per sentence, in document order.
+ */
+std::vector<SentenceResult> validateDocument(std::string_view document, ThreadPool& pool) {
+    const std::vector<size_t> ends = findSentenceEnds(document);
+    std::vector<SentenceResult> results(ends.size());
+    std::vector<CompilerSession> sessions(pool.size());            // One per worker
+
+    pool.parallelFor(ends.size(), [&](size_t worker, size_t index) {
+        const size_t begin = index == 0 ? 0 : ends[index - 1];
+        results[index] = validateSentence(document.substr(begin, ends[index] - begin), begin, sessions[worker]);
+    });
+    return results;
+}
+
+
+
+// Batch mode: many independent inputs validated in parallel
+/**
+ * @class BatchValidator
+ * @brief Validates large batches of independent inputs on a thread pool.
+ *
+ * Every worker has its own CompilerSession on its own cache lines, kept from one batch to the
+ * next, and writes its results straight into the caller's array, so the workers share nothing
+ * mutable apart from the pool's work ranges. To get the message for a failed input, validate
+ * it again with a CompilerSession and call describe().
+ */
+class BatchValidator {
+public:
+    /**
+     * @brief Constructor.
+     * @param pool Threads to run the batches on; must outlive the validator.
+     */
+    explicit BatchValidator(ThreadPool& pool) : pool(pool), sessions(pool.size()) {}
+
+    /**
+     * @brief Validates every input.
+     * @param inputs The inputs to check.
+     * @param count Number of inputs.
+     * @param results Array of @p count results, filled in input order.
+     */
+    void validate(const std::string_view* inputs, size_t count, ValidationResult* results) {
+        pool.parallelFor(count, [&](size_t worker, size_t index) {
+            results[index] = sessions[worker].session.validate(inputs[index]);
+        }, BATCH_GRAIN);
+    }
+
+    /**
+     * @brief Validates every input.
+     * @param inputs The inputs to check.
+     * @return std::vector<ValidationResult> One result per input, in input order.
+     */
+    std::vector<ValidationResult> validate(const std::vector<std::string_view>& inputs) {
+        std::vector<ValidationResult> results(inputs.size());
+        validate(inputs.data(), inputs.size(), results.data());
+        return results;
+    }
+
+private:
+    static constexpr size_t BATCH_GRAIN = 64;           ///< Inputs taken per step
+
+    struct alignas(64) WorkerSession {
+        CompilerSession session;
+    };
+
+    ThreadPool& pool;
+    std::vector<WorkerSession> sessions;                ///< One per worker
+};
+
+/**
+ * @brief Validates a batch of independent inputs in parallel (see BatchValidator).
+ * @param inputs The inputs to check.
+ * @param pool Threads to spread the inputs over.
+ * @return std::vector<ValidationResult> One result per input, in input order.
+ */
+std::vector<ValidationResult> validateBatch(const std::vector<std::string_view>& inputs, ThreadPool& pool) {
+    BatchValidator validator(pool);
+    return validator.validate(inputs);
+}
+
+
+
+// Document kept up to date under small edits
+/**
+ * @class IncrementalDocument
+ * @brief A document whose per-sentence results are updated in place as the text is edited.
+ *
+ * Sentences are lexed and parsed independently, so an edit only affects the sentences it
+ * touches: applyEdit() re-splits the text from the start of the first affected sentence until
+ * a sentence end lines up with an old one past the edit, and only the sentences in between are
+ * lexed and parsed again. Every other sentence keeps its tokens and compact AST.
+ *
+ * Both the text and the sentences are gap buffers split near the last edit. Sentences before
+ * the gap store their offset from the start of the text and sentences after it their distance
+ * to the end, so an edit shifts no offsets: it finds the first affected sentence with a binary
+ * search, moves the gaps there and replaces what it changes. The cost of an edit is thus set
+ * by the sentences it changes and the distance from the previous edit, not by the size of the
+ * document.
+ */
+class IncrementalDocument {
+public:
+    /**
+     * @brief Constructor that parses a whole document.
+     * @param initialText The document text (copied).
+     */
+    explicit IncrementalDocument(std::string_view initialText = std::string_view()) { setText(initialText); }
+
+    /**
+     * @brief Replaces the whole text and parses every sentence again.
+     * @param newText The document text (copied).
+     */
+    void setText(std::string_view newText) {
+        buffer.assign(newText.data(), newText.size());
+        gapBegin = buffer.size();
+        gapLength = 0;
+        before.clear();
+        after.clear();
+        lastReparsed = 0;
+        for (size_t begin = 0, end; (end = findSentenceEnd(newText, begin)) != std::string_view::npos; begin = end) {
+            before.push_back(compileSentence(newText.substr(begin, end - begin), begin));
+        }
+    }
+
+    /**
+     * @brief Applies a text edit and updates the affected sentences.
+     * @param offset Byte offset where the edit starts.
+     * @param removed Number of bytes removed at @p offset (clamped to the end of the text).
+     * @param inserted Text inserted at @p offset in their place.
+     * @return bool False, with nothing changed, if @p offset is past the end of the text.
+     */
+    bool applyEdit(size_t offset, size_t removed, std::string_view inserted) {
+        const size_t size = textSize();
+        if (offset > size) return false;
+        removed = std::min(removed, size - offset);
+
+        // The first sentence that reaches the edit is the first one that may change; an edit
+        // right at its end may extend it if it has no Stop. The gap is moved in front of it.
+        const auto endsBefore = [&](const std::unique_ptr<Sentence>& sentence) { return endOf(*sentence) < offset; };
+        const auto endsBeforeAfterGap = [&](const std::unique_ptr<Sentence>& sentence) {
+            return size - sentence->position + sentence->info.length < offset;
+        };
+        const size_t beforeCount = std::partition_point(before.begin(), before.end(), endsBefore) - before.begin();
+        if (beforeCount < before.size()) moveSentenceGap(beforeCount);
+        else moveSentenceGap(before.size() + (std::partition_point(after.rbegin(), after.rend(), endsBeforeAfterGap) - after.rbegin()));
+        const size_t editEnd = offset + removed;                // In old offsets
+        replaceText(offset, removed, inserted);
+
+        // Re-split until an end lines up with the end of an old sentence past the edit. From
+        // a sentence end on the splitting does not depend on earlier bytes, so the old
+        // sentences after it are still right. Old sentences are read from the back of after,
+        // nearest first; their distance to the end of the text does not change.
+        const size_t first = before.size();
+        const size_t base = before.empty() ? 0 : endOf(*before.back());
+        const std::string_view rest = textFrom(base);
+        size_t old = 0;
+        size_t replaced = after.size();                         // Old sentences taken off the back of after
+        for (size_t begin = 0, end; (end = findSentenceEnd(rest, begin)) != std::string_view::npos; begin = end) {
+            before.push_back(compileSentence(rest.substr(begin, end - begin), base + begin));
+            while (old < after.size() && (oldEnd(old, size) < editEnd || oldEnd(old, textSize()) < base + end)) ++old;
+            if (old < after.size() && oldEnd(old, textSize()) == base + end) {
+                replaced = old + 1;
+                break;
+            }
+        }
+
+        lastReparsed = before.size() - first;
+        after.resize(after.size() - replaced);
+        return true;
+    }
+
+    /**
+     * @brief Returns the current document text.
+     *
+     * The text gap is moved to the end first, so this costs a move of the bytes behind it, and
+     * like applyEdit() it must not run concurrently with other calls.
+     */
+    std::string_view text() const { return textFrom(0); }
+
+    size_t sentenceCount() const { return before.size() + after.size(); }               ///< Number of sentences
+    const std::vector<Token>& tokens(size_t index) const { return at(index).tokens; }   ///< Valid tokens of a sentence
+    const FlatAst& ast(size_t index) const { return at(index).ast; }                    ///< Tree of a sentence, empty if invalid
+    size_t reparsedCount() const { return lastReparsed; }                               ///< Sentences parsed by the last edit
+
+    /**
+     * @brief Returns the bounds and outcome of a sentence.
+     */
+    const SentenceResult& sentence(size_t index) const {
+        Sentence& sentence = at(index);
+        sentence.info.offset = index < before.size() ? sentence.position : textSize() - sentence.position;
+        return sentence.info;
+    }
+
+private:
+    /**
+     * @struct Sentence
+     * @brief Results of one sentence. Its tokens point into its own copy of the text, so it
+     *        stays valid however the document around it changes.
+     */
+    struct Sentence {
+        size_t position;                ///< Start offset before the gap; distance from the start to the end of the text after it
+        SentenceResult info;            ///< The offset is brought up to date by sentence()
+        std::string text;
+        std::vector<Token> tokens;      ///< Offsets are relative to the sentence; symbol ids are not kept
+        FlatAst ast;
+    };
+
+    // Lexes and parses one sentence starting at offset begin
+    std::unique_ptr<Sentence> compileSentence(std::string_view text, size_t begin) {
+        auto sentence = std::make_unique<Sentence>();
+        sentence->position = begin;
+        sentence->text.assign(text.data(), text.size());
+        const ValidationResult result = session.compileFlat(sentence->text, sentence->ast);
+        sentence->info = { begin, text.size(), result, result.ok() ? std::string() : describeDiagnostic(session.context().parseErrors.front()) };
+        sentence->tokens = session.tokens();
+        return sentence;
+    }
+
+    // Sentence by document index
+    Sentence& at(size_t index) const {
+        return index < before.size() ? *before[index] : *after[after.size() - 1 - (index - before.size())];
+    }
+
+    // End offset of a sentence before the gap
+    static size_t endOf(const Sentence& sentence) { return sentence.position + sentence.info.length; }
+
+    // End offset of the old sentence that many places after the gap, in a text of the given size
+    size_t oldEnd(size_t old, size_t size) const {
+        const Sentence& sentence = *after[after.size() - 1 - old];
+        return size - sentence.position + sentence.info.length;
+    }
+
+    // Moves sentences across the gap until the given number of them are in front of it
+    void moveSentenceGap(size_t count) {
+        const size_t size = textSize();
+        while (before.size() > count) {
+            before.back()->position = size - before.back()->position;
+            after.push_back(std::move(before.back()));
+            before.pop_back();
+        }
+        while (before.size() < count) {
+            after.back()->position = size - after.back()->position;
+            before.push_back(std::move(after.back()));
+            after.pop_back();
+        }
+    }
+
+    size_t textSize() const { return buffer.size() - gapLength; }
+
+    // Moves the text gap to a text offset, moving only the bytes in between
+    void moveTextGap(size_t offset) const {
+        if (offset < gapBegin) {
+            std::memmove(&buffer[offset + gapLength], &buffer[offset], gapBegin - offset);
+        } else if (offset > gapBegin) {
+            std::memmove(&buffer[gapBegin], &buffer[gapBegin + gapLength], offset - gapBegin);
+        }
+        gapBegin = offset;
+    }
+
+    // Returns the text from an offset to the end, which is contiguous once the gap is in front of it
+    std::string_view textFrom(size_t offset) const {
+        moveTextGap(offset);
+        return std::string_view(buffer).substr(offset + gapLength);
+    }
+
+    // Replaces bytes of the text at the gap, growing the buffer geometrically if the gap is too small
+    void replaceText(size_t offset, size_t removed, std::string_view inserted) {
+        moveTextGap(offset);
+        gapLength += removed;
+        if (inserted.size() > gapLength) {
+            const size_t tail = buffer.size() - gapBegin - gapLength;
+            const size_t grown = inserted.size() + buffer.size() / 8 + 64;
+            buffer.resize(buffer.size() + grown);
+            std::memmove(&buffer[buffer.size() - tail], &buffer[gapBegin + gapLength], tail);
+            gapLength += grown;
+        }
+        if (!inserted.empty()) std::memcpy(&buffer[gapBegin], inserted.data(), inserted.size());
+        gapBegin += inserted.size();
+        gapLength -= inserted.size();
+    }
+
+    mutable std::string buffer;                         ///< The text, with gapLength unused bytes at gapBegin
+    mutable size_t gapBegin = 0;
+    size_t gapLength = 0;
+    std::vector<std::unique_ptr<Sentence>> before;      ///< Sentences in front of the gap, in document order
+    std::vector<std::unique_ptr<Sentence>> after;       ///< Sentences behind the gap, the nearest last
+    CompilerSession session;                            ///< Reused to parse each changed sentence
+    size_t lastReparsed = 0;                            ///< Sentences parsed by the last applyEdit()
+};
+
+
+
+// Binary format for tokens and ASTs
+/**
+ * Layout, all integers after the header being LEB128 varints:
+ *
+ *     header    'C' 'A' 'S' 'T', uint16 version, uint16 flags (little-endian)
+ *     pool      byte count, then the bytes of every symbol name (in id order) followed by
+ *               the text of every token without a symbol (in token order)
+ *     symbols   count, then the byte length of each name
+ *     tokens    count, then per token its TokenType, its offset as a zigzag delta from the
+ *               previous token's (version 2), then the symbol id + 1 for words
+ *               and startwords and, for quotations and for words without a symbol (the
+ *               26-letter pieces of split words), the byte length of their pooled text
+ *     ast       node count, then per node its NodeKind, the distance back to its parent
+ *               (0 for the root) and its token index + 1 (0 for none)
+ *
+ * Nodes are stored in FlatAst order, so parents always precede their children.
+ */
+constexpr char BINARY_MAGIC[4] = { 'C', 'A', 'S', 'T' };
+constexpr uint16_t BINARY_VERSION = 2;          ///< Version 1 had no token offsets
+constexpr size_t BINARY_HEADER_SIZE = 8;
+
+/**
+ * @struct CompiledImage
+ * @brief Tokens and AST read back from the binary format.
+ *
+ * Symbol names and token values point into the buffer that was read, which must outlive the
+ * image. Reading into the same image again reuses its storage.
+ */
+struct CompiledImage {
+    std::vector<std::string_view> symbols;  ///< Symbol names, indexed by Token::symbol
+    std::vector<Token> tokens;
+    FlatAst ast;                            ///< Empty if none was written
+};
+
+/**
+ * @brief Appends a LEB128 varint to a buffer.
+ */
+inline void writeVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * @brief Decodes a LEB128 varint.
+ * @param data Cursor into the buffer, advanced past the varint.
+ * @param end End of the buffer.
+ * @param value Receives the value.
+ * @return bool False if the varint is truncated or does not fit in @p value.
+ */
+inline bool readVarint(const unsigned char*& data, const unsigned char* end, uint64_t& value) {
+    uint64_t result = 0;
+    for (unsigned shift = 0; data < end && shift < 64; shift += 7) {
+        const unsigned char byte = *data++;
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool readVarint(const unsigned char*& data, const unsigned char* end, uint32_t& value) {
+    uint64_t result;
+    if (!readVarint(data, end, result) || result > 0xFFFFFFFFu) return false;
+    value = static_cast<uint32_t>(result);
+    return true;
+}
+
+/**
+ * @brief Whether writeBinary() stores the text of a token in the string pool.
+ */
+inline bool isPooledToken(const Token& token) {
+    return token.type == QUOTATION || ((token.type == WORD || token.type == STARTWORD) && token.symbol == NO_SYMBOL);
+}
+
+/**
+ * @brief Serializes a token stream and its AST.
+ * @param tokens Valid tokens, as produced by Lexer::tokenizeAll().
+ * @param symbols The symbol table the tokens' symbol ids refer to.
+ * @param ast The compact AST over @p tokens, or nullptr to store none.
+ * @param out Buffer the image is appended to.
+ * @return size_t The number of bytes appended.
+ */
+size_t writeBinary(const std::vector<Token>& tokens, const SymbolTable& symbols, const FlatAst* ast, std::string& out) {
+    const size_t start = out.size();
+    out.append(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    out.push_back(static_cast<char>(BINARY_VERSION & 0xff));
+    out.push_back(static_cast<char>(BINARY_VERSION >> 8));
+    out.append(2, '\0');                                    // Flags
+
+    size_t poolSize = 0;
+    for (uint32_t id = 0; id < symbols.size(); ++id) poolSize += symbols.name(id).size();
+    for (const Token& token : tokens) {
+        if (isPooledToken(token)) poolSize += token.value.size();
+    }
+    writeVarint(out, poolSize);
+    for (uint32_t id = 0; id < symbols.size(); ++id) out.append(symbols.name(id));
+    for (const Token& token : tokens) {
+        if (isPooledToken(token)) out.append(token.value);
+    }
+
+    writeVarint(out, symbols.size());
+    for (uint32_t id = 0; id < symbols.size(); ++id) writeVarint(out, symbols.name(id).size());
+
+    writeVarint(out, tokens.size());
+    size_t previousOffset = 0;
+    for (const Token& token : tokens) {
+        const int64_t delta = static_cast<int64_t>(token.offset - previousOffset);
+        previousOffset = token.offset;
+        writeVarint(out, token.type);
+        writeVarint(out, static_cast<uint64_t>(delta) << 1 ^ static_cast<uint64_t>(delta >> 63));
+        if (token.type == WORD || token.type == STARTWORD) writeVarint(out, token.symbol == NO_SYMBOL ? 0 : token.symbol + 1ull);
+        if (isPooledToken(token)) writeVarint(out, token.value.size());
+    }
+
+    const size_t nodes = ast ? ast->size() : 0;
+    writeVarint(out, nodes);
+    std::vector<uint32_t> parents(nodes, NO_NODE);
+    for (uint32_t node = 0; node < nodes; ++node) {
+        for (uint32_t child = ast->firstChild[node]; child != NO_NODE; child = ast->nextSibling[child]) {
+            parents[child] = node;
+        }
+        writeVarint(out, ast->kinds[node]);
+        writeVarint(out, parents[node] == NO_NODE ? 0 : node - parents[node]);
+        writeVarint(out, ast->tokenIndices[node] == NO_TOKEN ? 0 : ast->tokenIndices[node] + 1ull);
+    }
+    return out.size() - start;
+}
+
+/**
+ * @brief Reads back an image written by writeBinary().
+ * @param blob The image (version 1 or 2), for example a MappedFile view. It is borrowed by @p image.
+ * @param image Receives the symbols, tokens and AST; left empty if the image is rejected.
+ * @return bool False if the magic or version is wrong or the image is truncated or malformed.
+ *
+ * Nothing is allocated per token or node: the vectors of @p image are sized once from the
+ * section counts, and all text stays in @p blob.
+ */
+bool readBinary(std::string_view blob, CompiledImage& image) {
+    image.symbols.clear();
+    image.tokens.clear();
+    image.ast.clear();
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(blob.data());
+    const unsigned char* end = data + blob.size();
+    if (blob.size() < BINARY_HEADER_SIZE || std::memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) return false;
+    const unsigned version = data[4] | data[5] << 8;
+    if (version < 1 || version > BINARY_VERSION) return false;
+    data += BINARY_HEADER_SIZE;
+
+    auto fail = [&image]() {
+        image.symbols.clear();
+        image.tokens.clear();
+        image.ast.clear();
+        return false;
+    };
+
+    uint32_t poolSize;
+    if (!readVarint(data, end, poolSize) || poolSize > static_cast<size_t>(end - data)) return fail();
+    const char* pool = reinterpret_cast<const char*>(data);
+    size_t poolUsed = 0;
+    data += poolSize;
+
+    // Every entry takes at least one byte, which bounds the counts before reserving
+    uint32_t count;
+    if (!readVarint(data, end, count) || count > static_cast<size_t>(end - data)) return fail();
+    image.symbols.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t length;
+        if (!readVarint(data, end, length) || length > poolSize - poolUsed) return fail();
+        image.symbols.emplace_back(pool + poolUsed, length);
+        poolUsed += length;
+    }
+
+    if (!readVarint(data, end, count) || count > static_cast<size_t>(end - data)) return fail();
+    image.tokens.reserve(count);
+    size_t offset = 0;                                      // Offsets are 0 in version 1
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t type, value, symbol = 0;
+        if (!readVarint(data, end, type)) return fail();
+        if (version >= 2) {
+            uint64_t zigzag;
+            if (!readVarint(data, end, zigzag)) return fail();
+            offset += static_cast<size_t>((zigzag >> 1) ^ (0 - (zigzag & 1)));
+        }
+        switch (type) {
+            case STARTWORD:
+            case WORD:
+                if (!readVarint(data, end, symbol) || symbol > image.symbols.size()) return fail();
+                if (symbol > 0) {
+                    image.tokens.push_back({ static_cast<TokenType>(type), image.symbols[symbol - 1], symbol - 1, offset });
+                    break;
+                }
+                // Split word piece: its text is pooled like a quotation
+                [[fallthrough]];
+            case QUOTATION:
+                if (!readVarint(data, end, value) || value > poolSize - poolUsed) return fail();
+                image.tokens.push_back({ static_cast<TokenType>(type), std::string_view(pool + poolUsed, value), NO_SYMBOL, offset });
+                poolUsed += value;
+                break;
+            case COMMA: image.tokens.push_back({ COMMA, ",", NO_SYMBOL, offset }); break;
+            case HYPHEN: image.tokens.push_back({ HYPHEN, "-", NO_SYMBOL, offset }); break;
+            case STOP: image.tokens.push_back({ STOP, ".", NO_SYMBOL, offset }); break;
+            default: return fail();
+        }
+    }
+
+    if (!readVarint(data, end, count) || count > static_cast<size_t>(end - data) / 3) return fail();
+    image.ast.reserve(count);
+    for (uint32_t node = 0; node < count; ++node) {
+        uint32_t kind, parentDistance, token;
+        if (!readVarint(data, end, kind) || !readVarint(data, end, parentDistance) || !readVarint(data, end, token)) return fail();
+        if (kind > NODE_STOP || parentDistance > node || (node > 0) != (parentDistance > 0) || token > image.tokens.size()) return fail();
+        image.ast.add(parentDistance ? node - parentDistance : NO_NODE, static_cast<NodeKind>(kind), token ? token - 1 : NO_TOKEN);
+    }
+    if (data != end) return fail();                          // Trailing bytes
+    return true;
+}
+
+
+
+// Input file mapped into memory
+/**
+ * @class MappedFile
+ * @brief Read-only view of a whole input file for the Lexer to borrow.
+ *
+ * Regular files are mapped with mmap() and advised for sequential access, so even very large
+ * corpora are paged in on demand instead of being copied to the heap. Anything that cannot be
+ * mapped (pipes, special files, platforms without mmap) is read in chunks into an owned buffer.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Opens a file, replacing any file opened before.
+     * @param path The file to open.
+     * @param error Receives a message describing the failure.
+     * @return bool True if the whole file is available through view().
+     */
+    bool open(const char* path, std::string& error) {
+        close();
+#ifdef INPUT_HAVE_MMAP
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            error = std::string("Cannot open ") + path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            length = static_cast<size_t>(info.st_size);
+            if (length == 0) {                               // mmap() rejects empty mappings
+                ::close(fd);
+                return true;
+            }
+            void* pages = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (pages != MAP_FAILED) {
+                ::close(fd);                                 // The mapping keeps the file alive
+                madvise(pages, length, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(pages);
+                mapped = true;
+                return true;
+            }
+            length = 0;
+        }
+        const bool ok = readAll(fd, path, error);
+        ::close(fd);
+        return ok;
+#else
+        std::FILE* file = std::fopen(path, "rb");
+        if (!file) {
+            error = std::string("Cannot open ") + path;
+            return false;
+        }
+        const bool ok = readAll(file, path, error);
+        std::fclose(file);
+        return ok;
+#endif
+    }
+
+    /**
+     * @brief The file contents, valid until the file is closed or reopened.
+     */
+    std::string_view view() const { return std::string_view(data, length); }
+
+    /**
+     * @brief Whether the contents are mapped pages rather than a heap copy.
+     */
+    bool isMapped() const { return mapped; }
+
+    /**
+     * @brief Releases the mapping or buffer.
+     */
+    void close() {
+#ifdef INPUT_HAVE_MMAP
+        if (mapped) munmap(const_cast<char*>(data), length);
+#endif
+        data = nullptr;
+        length = 0;
+        mapped = false;
+        buffer.clear();
+        buffer.shrink_to_fit();
+    }
+
+private:
+    static constexpr size_t READ_CHUNK = 1 << 16;   ///< Bytes requested per read
+
+#ifdef INPUT_HAVE_MMAP
+    // Fallback reader for descriptors that cannot be mapped
+    bool readAll(int fd, const char* path, std::string& error) {
+        size_t used = 0;
+        for (;;) {
+            buffer.resize(used + READ_CHUNK);
+            const ssize_t got = ::read(fd, buffer.data() + used, READ_CHUNK);
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                error = std::string("Cannot read ") + path + ": " + std::strerror(errno);
+                buffer.clear();
+                return false;
+            }
+            if (got == 0) break;
+            used += static_cast<size_t>(got);
+        }
+        buffer.resize(used);
+        data = buffer.data();
+        length = used;
+        return true;
+    }
+#else
+    // Portable reader used where mmap() is unavailable
+    bool readAll(std::FILE* file, const char* path, std::string& error) {
+        size_t used = 0;
+        for (;;) {
+            buffer.resize(used + READ_CHUNK);
+            const size_t got = std::fread(buffer.data() + used, 1, READ_CHUNK, file);
+            used += got;
+            if (got < READ_CHUNK) break;
+        }
+        if (std::ferror(file)) {
+            error = std::string("Cannot read ") + path;
+            buffer.clear();
+            return false;
+        }
+        buffer.resize(used);
+        data = buffer.data();
+        length = used;
+        return true;
+    }
+#endif
+
+    const char* data = nullptr;     ///< First byte of the contents
+    size_t length = 0;              ///< Byte length of the contents
+    bool mapped = false;            ///< True if data points to mapped pages
+    std::vector<char> buffer;       ///< Contents read by the fallback reader
+};
+
+
+
+// Helper function to convert NodeKind enum to its printed label
+std::string_view nodeKindToString(NodeKind kind) {
+    switch (kind) {
+        case NODE_SENTENCE: return "Sentence";
+        case NODE_STARTWORD: return "Startword";
+        case NODE_WORD: return "Word";
+        case NODE_COMMA: return "Comma";
+        case NODE_HYPHEN: return "Hyphen";
+        case NODE_QUOTATION: return "Quotation";
+        case NODE_STOP: return "Stop";
+        default: return "Unknown";
+    }
+}
+
+
+// Helper function to print one AST node
+void printASTNode(NodeKind kind, uint32_t tokenIndex, const std::vector<Token>& tokens, OutputSink& out) {
+    out << nodeKindToString(kind);
+    if (kind == NODE_STARTWORD || kind == NODE_WORD || kind == NODE_QUOTATION) {
+        out << ": " << tokens[tokenIndex].value;
+    }
+    out << " ";
+}
+
+
+// Helper function to print the AST structure in level-order format
+/**
+ * @brief Prints the AST one level per line.
+ * @param root Root of the tree returned by Parser::parse().
+ * @param tokens The tokens the tree was parsed from; node text is read from them.
+ * @param out Where to print.
+ */
+void printASTLevelOrder(const ASTNode* root, const std::vector<Token>& tokens, OutputSink& out = standardOutput()) {
+    if (!root) return;
+    COMPILER_TIME_PHASE(PHASE_PRINT);
+
+    std::vector<const ASTNode*> level = { root };
+    std::vector<const ASTNode*> nextLevel;
+
+    while (!level.empty()) {
+        // Process all nodes at the current level
+        for (const ASTNode* currentNode : level) {
+            printASTNode(currentNode->kind, currentNode->tokenIndex, tokens, out);
+
+            // Collect all children of the current node
+            for (const ASTNode* child = currentNode->firstChild; child; child = child->nextSibling) {
+                nextLevel.push_back(child);
+            }
+        }
+        level.swap(nextLevel);
+        nextLevel.clear();
+
+        out << '\n';  // Print a newline after each level
+    }
+}
+
+/**
+ * @brief Prints a compact AST one level per line, in the same format as for ASTNode trees.
+ * @param ast Tree filled by Parser::parseFlat().
+ * @param tokens The tokens the tree was parsed from; node text is read from them.
+ * @param out Where to print.
+ */
+void printASTLevelOrder(const FlatAst& ast, const std::vector<Token>& tokens, OutputSink& out = standardOutput()) {
+    if (ast.size() == 0) return;
+    COMPILER_TIME_PHASE(PHASE_PRINT);
+
+    std::vector<uint32_t> level = { 0 };
+    std::vector<uint32_t> nextLevel;
+
+    while (!level.empty()) {
+        for (uint32_t node : level) {
+            printASTNode(ast.kinds[node], ast.tokenIndices[node], tokens, out);
+
+            for (uint32_t child = ast.firstChild[node]; child != NO_NODE; child = ast.nextSibling[child]) {
+                nextLevel.push_back(child);
+            }
+        }
+        level.swap(nextLevel);
+        nextLevel.clear();
+
+        out << '\n';
+    }
+}
+
+
+
+// Helper function to convert TokenType enum to a string
+std::string_view tokenTypeToString(TokenType type) {
+    switch (type) {
+        case STARTWORD: return "STARTWORD";
+        case WORD: return "WORD";
+        case COMMA: return "COMMA";
+        case HYPHEN: return "HYPHEN";
+        case STOP: return "STOP";
+        case QUOTATION: return "QUOTATION";
+        case INVALID: return "INVALID";
+        case END: return "END";
+        default: return "UNKNOWN";
+    }
+}
+
+
+
+#ifdef COMPILER_BENCHMARK
+// Benchmark suite
+/*
+ * Built with -DCOMPILER_BENCHMARK (and -lbenchmark -pthread), the program runs these
+ * benchmarks instead of main(). Every benchmark runs once per generated corpus and reports
+ * bytes/s or items/s, so results can be kept for regression tracking with
+ * --benchmark_format=json or --benchmark_out=results.json.
+ */
+
+/**
+ * @brief Kinds of generated input, one benchmark argument each.
+ */
+enum BenchCorpus {
+    CORPUS_SHORT,           ///< Short valid sentences
+    CORPUS_LONG_WORDS,      ///< Valid sentences full of words longer than 26 letters, which get split
+    CORPUS_PUNCTUATION,     ///< Long comma and hyphen runs ending in consecutive-hyphen pairs
+    CORPUS_QUOTATIONS,      ///< Sentences with long quotations
+    CORPUS_INVALID,         ///< Mostly invalid tokens: digits, short words, stray symbols
+    CORPUS_COUNT
+};
+
+/**
+ * @brief Deterministic xorshift generator, so every run measures the same corpora.
+ */
+class BenchRandom {
+public:
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    size_t below(size_t bound) { return static_cast<size_t>(next() % bound); }
+
+private:
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+};
+
+void appendBenchWord(std::string& out, BenchRandom& random, size_t length, bool capital) {
+    for (size_t i = 0; i < length; ++i) {
+        const char letter = static_cast<char>('a' + random.below(26));
+        out += (i == 0 && capital) ? static_cast<char>(letter - 'a' + 'A') : letter;
+    }
+}
+
+/**
+ * @brief Generates one sentence of the given corpus kind.
+ */
+std::string makeBenchSentence(BenchCorpus corpus, BenchRandom& random) {
+    std::string sentence;
+    appendBenchWord(sentence, random, 3 + random.below(8), true);
+
+    switch (corpus) {
+        case CORPUS_SHORT:
+            for (size_t words = 2 + random.below(6); words > 0; --words) {
+                sentence += random.below(5) == 0 ? ", " : " ";
+                appendBenchWord(sentence, random, 3 + random.below(10), false);
+            }
+            break;
+        case CORPUS_LONG_WORDS:
+            for (size_t words = 10 + random.below(10); words > 0; --words) {
+                sentence += ' ';
+                appendBenchWord(sentence, random, random.below(2) ? 27 + random.below(40) : 3 + random.below(20), false);
+            }
+            break;
+        case CORPUS_PUNCTUATION:
+            for (size_t words = 100 + random.below(100); words > 0; --words) {
+                sentence += random.below(2) ? ", " : "-";
+                appendBenchWord(sentence, random, 3 + random.below(4), false);
+            }
+            // Hyphen pairs make the Parser count the commas up to the Stop. Half of the sentences
+            // end with the single comma that makes them valid; the rest fail at the first pair.
+            for (size_t words = 100 + random.below(100); words > 0; --words) {
+                sentence += words % 8 == 0 ? " - - " : "-";
+                appendBenchWord(sentence, random, 3 + random.below(4), false);
+            }
+            if (random.below(2)) {
+                sentence += ", ";
+                appendBenchWord(sentence, random, 3 + random.below(4), false);
+            }
+            break;
+        case CORPUS_QUOTATIONS:
+            for (size_t quotes = 1 + random.below(3); quotes > 0; --quotes) {
+                sentence += " '";
+                const size_t length = 200 + random.below(2000);
+                for (size_t i = 0; i < length; ++i) {
+                    sentence += random.below(6) == 0 ? ' ' : static_cast<char>('a' + random.below(26));
+                }
+                sentence += "' ";
+                appendBenchWord(sentence, random, 3 + random.below(10), false);
+            }
+            break;
+        case CORPUS_INVALID:
+            for (size_t words = 10 + random.below(20); words > 0; --words) {
+                sentence += ' ';
+                switch (random.below(4)) {
+                    case 0: sentence += std::to_string(random.next() % 100000); break;
+                    case 1: appendBenchWord(sentence, random, 1 + random.below(2), false); break;
+                    case 2: sentence += "#@"; appendBenchWord(sentence, random, 3, false); break;
+                    default: appendBenchWord(sentence, random, 3 + random.below(10), false); break;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    sentence += '.';
+    return sentence;
+}
+
+/**
+ * @brief Returns the inputs of a corpus: independent sentences adding up to about 256 KB.
+ */
+const std::vector<std::string>& benchCorpus(BenchCorpus corpus) {
+    static std::vector<std::string> corpora[CORPUS_COUNT];
+    std::vector<std::string>& inputs = corpora[corpus];
+    if (inputs.empty()) {
+        BenchRandom random;
+        for (size_t bytes = 0; bytes < (256u << 10); bytes += inputs.back().size()) {
+            inputs.push_back(makeBenchSentence(corpus, random));
+        }
+    }
+    return inputs;
+}
+
+const char* benchCorpusName(BenchCorpus corpus) {
+    static const char* const NAMES[CORPUS_COUNT] = { "short", "long_words", "punctuation", "quotations", "invalid" };
+    return NAMES[corpus];
+}
+
+size_t benchCorpusBytes(const std::vector<std::string>& inputs) {
+    size_t bytes = 0;
+    for (const std::string& input : inputs) bytes += input.size();
+    return bytes;
+}
+
+/**
+ * @brief Corpus inputs lexed once, as Tokens and as packed tokens, each with the Parsers that
+ *        benchmarks reuse.
+ */
+struct BenchLexedCorpus {
+    struct Input {
+        CompilationContext context;
+        std::vector<Token> tokens;
+        PackedTokenStream packed;
+        Parser parser{ tokens, context };
+        PackedParser packedParser{ packed, context };
+    };
+
+    std::vector<std::unique_ptr<Input>> inputs;
+    size_t tokenCount = 0;
+
+    explicit BenchLexedCorpus(BenchCorpus corpus) {
+        for (const std::string& text : benchCorpus(corpus)) {
+            auto input = std::make_unique<Input>();
+            Lexer lexer(text, input->context);
+            lexer.tokenizeAll(input->tokens);
+            Lexer packedLexer(text, input->context);
+            std::string error;
+            packedLexer.tokenizePacked(input->packed, error);
+            tokenCount += input->tokens.size();
+            inputs.push_back(std::move(input));
+        }
+    }
+};
+
+// Lexer::nextToken() over every input, without storing the tokens
+void BM_LexNextToken(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    const std::vector<std::string>& inputs = benchCorpus(corpus);
+    CompilationContext context;
+    Lexer lexer(std::string_view(), context);
+    size_t tokens = 0;
+
+    for (auto _ : state) {
+        for (const std::string& input : inputs) {
+            lexer.reset(input);
+            for (Token token = lexer.nextToken(); token.type != END; token = lexer.nextToken()) {
+                benchmark::DoNotOptimize(token);
+                ++tokens;
+            }
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * benchCorpusBytes(inputs)));
+    state.SetItemsProcessed(static_cast<int64_t>(tokens));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+// Parser::validate(): the grammar alone, nothing built
+void BM_ParseValidate(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    BenchLexedCorpus lexed(corpus);
+
+    for (auto _ : state) {
+        for (auto& input : lexed.inputs) {
+            benchmark::DoNotOptimize(input->parser.validate());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lexed.tokenCount));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+// PackedParser::validate(): the same checks reading 8-byte packed tokens in place
+void BM_ParseValidatePacked(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    BenchLexedCorpus lexed(corpus);
+
+    for (auto _ : state) {
+        for (auto& input : lexed.inputs) {
+            benchmark::DoNotOptimize(input->packedParser.validate());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lexed.tokenCount));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+// Parser::parse(): grammar plus the ASTNode tree and error messages
+void BM_ParseTree(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    BenchLexedCorpus lexed(corpus);
+
+    for (auto _ : state) {
+        for (auto& input : lexed.inputs) {
+            benchmark::DoNotOptimize(input->parser.parse());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lexed.tokenCount));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+// Parser::parseFlat(): grammar plus the compact array tree
+void BM_ParseFlat(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    BenchLexedCorpus lexed(corpus);
+    FlatAst ast;
+
+    for (auto _ : state) {
+        for (auto& input : lexed.inputs) {
+            benchmark::DoNotOptimize(input->parser.parseFlat(ast));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lexed.tokenCount));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+// printASTLevelOrder() of every valid input into memory (the invalid corpus has nothing to print)
+void BM_PrintAst(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    BenchLexedCorpus lexed(corpus);
+    std::vector<std::pair<const ASTNode*, const std::vector<Token>*>> trees;
+    for (auto& input : lexed.inputs) {
+        if (const ASTNode* root = input->parser.parse()) trees.emplace_back(root, &input->tokens);
+    }
+
+    std::string text;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        text.clear();
+        {
+            StringSink out(text);
+            for (const auto& tree : trees) printASTLevelOrder(tree.first, *tree.second, out);
+        }
+        bytes += text.size();
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * trees.size()));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+// End to end: CompilerSession::compile() of every input
+void BM_Compile(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    const std::vector<std::string>& inputs = benchCorpus(corpus);
+    CompilerSession session;
+
+    for (auto _ : state) {
+        for (const std::string& input : inputs) {
+            benchmark::DoNotOptimize(session.compile(input));
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * benchCorpusBytes(inputs)));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * inputs.size()));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+// Validation only: CompilerSession::validate() of every input (screened, then streamed)
+void BM_SessionValidate(benchmark::State& state) {
+    const BenchCorpus corpus = static_cast<BenchCorpus>(state.range(0));
+    const std::vector<std::string>& inputs = benchCorpus(corpus);
+    CompilerSession session;
+
+    for (auto _ : state) {
+        for (const std::string& input : inputs) {
+            benchmark::DoNotOptimize(session.validate(input));
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * benchCorpusBytes(inputs)));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * inputs.size()));
+    state.SetLabel(benchCorpusName(corpus));
+}
+
+BENCHMARK(BM_LexNextToken)->DenseRange(0, CORPUS_COUNT - 1);
+BENCHMARK(BM_ParseValidate)->DenseRange(0, CORPUS_COUNT - 1);
+BENCHMARK(BM_ParseValidatePacked)->DenseRange(0, CORPUS_COUNT - 1);
+BENCHMARK(BM_ParseTree)->DenseRange(0, CORPUS_COUNT - 1);
+BENCHMARK(BM_ParseFlat)->DenseRange(0, CORPUS_COUNT - 1);
+BENCHMARK(BM_PrintAst)->DenseRange(0, CORPUS_QUOTATIONS);
+BENCHMARK(BM_Compile)->DenseRange(0, CORPUS_COUNT - 1);
+BENCHMARK(BM_SessionValidate)->DenseRange(0, CORPUS_COUNT - 1);
+
+BENCHMARK_MAIN();
+
+#elif defined(COMPILER_FUZZER)
+// Fuzzing harness
+/*
+ * Built with -DCOMPILER_FUZZER (clang++ -fsanitize=fuzzer,address), the program is a
+ * libFuzzer target instead of the compiler. Every input goes through a reference port of the
+ * original character-by-character Lexer and Parser and through each fast path: the scanning
+ * kernels, tokenizeAll, tokenizePacked, ChunkedLexer, parse, parseFlat, validate, the
+ * streaming validator, diagnose, ParseCache, the binary format, validateDocument, a few
+ * IncrementalDocument edits and BatchValidator over the input's lines. Tokens, validity,
+ * every diagnostic, the sentence splits and the printed errors, accepted string and AST must
+ * match byte for byte. Inputs recorded in fuzzRegressions are replayed at start-up. Inputs
+ * that are four times longer must also not take more than eight times as long or allocate
+ * more than four times as often. Any mismatch aborts, so the fuzzer keeps the input. Adding
+ * -DCOMPILER_FUZZER_STANDALONE gives a main() that replays input files without libFuzzer.
+ */
+
+constexpr size_t FUZZ_MAX_INPUT = 1 << 16;              ///< Longer inputs are skipped
+constexpr size_t FUZZ_MAX_SCALED_INPUT = 4096;          ///< Longest input the scaling check repeats
+constexpr uint64_t FUZZ_TIME_SLACK_NS = 1000000;        ///< Timer noise allowed by the scaling check
+constexpr uint64_t FUZZ_ALLOCATION_SLACK = 64;          ///< Extra growth steps allowed by the scaling check
+
+std::atomic<uint64_t> fuzzAllocations{ 0 };             ///< Calls of the global operator new
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"    // GCC does not see that new and delete are both replaced
+#endif
+
+void* operator new(size_t size) {
+    fuzzAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    fuzzAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+
+/**
+ * @brief Aborts with a message naming the failed check, so the fuzzer records the input.
+ */
+void fuzzExpect(bool ok, const char* check, std::string_view input) {
+    if (ok) return;
+    std::cerr << "fuzz check failed: " << check << " (input of " << input.size() << " bytes)\n";
+    std::abort();
+}
+
+/**
+ * @struct ReferenceToken
+ * @brief Token of the reference Lexer, owning its text like the original Token did.
+ */
+struct ReferenceToken {
+    TokenType type;
+    std::string value;
+    size_t offset;                  ///< Where the token starts (at the opening quote for quotations)
+};
+
+/**
+ * @brief Printed outcome of the reference Parser.
+ */
+struct ReferenceResult {
+    bool valid = false;
+    std::string errors;             ///< Lines printed by printErrors()
+    std::string accepted;           ///< Line printed by printAcceptedString(), if valid
+    std::string ast;                ///< Lines printed by printASTLevelOrder(), if valid
+};
+
+// Original Lexer::nextToken, one character at a time (C locale classification)
+ReferenceToken referenceNextToken(std::string_view input, size_t& pos) {
+    auto space = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    auto alpha = [](char c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; };
+
+    while (pos < input.length() && space(input[pos])) pos++;
+    const size_t start = pos;
+    if (pos >= input.length()) return { END, "", start };
 
-    /**
-    * @brief Retrieves the current token.
-    * @return Token The current token in the token sequence.
-    */
-    Token currentToken() {
-        if (currentPos >= tokens.size()) return { END, "" };
-        return tokens[currentPos];
+    const char current = input[pos];
+    if (current == ',') { pos++; return { COMMA, ",", start }; }
+    if (current == '-') { pos++; return { HYPHEN, "-", start }; }
+    if (current == '.') { pos++; return { STOP, ".", start }; }
+
+    if (current == '\'') {
+        pos++;
+        std::string quotedText;
+        while (pos < input.length() && input[pos] != '\'') quotedText += input[pos++];
+        if (pos < input.length()) pos++;
+        return { QUOTATION, quotedText, start };
     }
 
-    /**
-     * @brief Advances to the next token.
-     */
-    void advanceToken() {
-        if (currentPos < tokens.size()) {
-            currentPos++;
+    std::string word;
+    while (pos < input.length() && alpha(input[pos])) word += input[pos++];
+    if (!word.empty()) {
+        if (word.length() > 26) {
+            pos -= word.length() - 26;
+            return { WORD, word.substr(0, 26), start };
         }
+        if (word.length() >= 3) {
+            return { std::isupper(static_cast<unsigned char>(word[0])) ? STARTWORD : WORD, word, start };
+        }
+        return { INVALID, word, start };
     }
 
-    /**
-     * @brief Parses a sentence according to the syntactic rules.
-     * 
-     * The parseSentence() method parses tokens as a valid sentence, ensuring that 
-     * the input starts with a Startword and ends with a Stop. It also handles commas, 
-     * hyphens, and quotations as per the defined grammar.
-     * 
-     * @return std::shared_ptr<ASTNode> The root node representing the sentence, or nullptr if there are errors.
-     */
-    std::shared_ptr<ASTNode> parseSentence() {
-    std::shared_ptr<ASTNode> sentenceNode = std::make_shared<ASTNode>("Sentence");
+    std::string invalidToken;
+    while (pos < input.length() && !space(input[pos]) && input[pos] != ',' && input[pos] != '-' && input[pos] != '.') {
+        invalidToken += input[pos++];
+    }
+    return { INVALID, invalidToken, start };
+}
 
-    std::shared_ptr<ASTNode> startNode = parseStartword();
-    if (startNode) {
-        sentenceNode->addChild(startNode);
-        acceptedTokens.push_back(tokens[currentPos - 1]);
-    } else {
-        return nullptr;
+// Original Parser::parseSentence, with its whole-sentence comma scan after each repeated hyphen
+ReferenceResult referenceParse(const std::vector<ReferenceToken>& tokens, bool lexicalErrors) {
+    ReferenceResult result;
+    std::vector<const ReferenceToken*> accepted;
+    std::string children;
+    size_t pos = 0;
+
+    auto fail = [&](const std::string& message) {
+        result.errors = message + "\n";
+        return result;
+    };
+    auto add = [&](const char* label, bool withValue) {
+        children += label;
+        if (withValue) children += ": " + tokens[pos].value;
+        children += ' ';
+        accepted.push_back(&tokens[pos]);
+        pos++;
+    };
+
+    if (tokens.empty() || tokens[0].type != STARTWORD) {
+        return fail("Expected Startword, got: " + (tokens.empty() ? std::string() : tokens[0].value));
     }
+    add("Startword", true);
 
     bool lastWasComma = false;
     bool lastWasHyphen = false;
-
-    while (currentPos < tokens.size() && currentToken().type != STOP) {
-        if (currentToken().type == COMMA) {
-            if (lastWasComma) {
-                errors.push_back("Error: Consecutive commas found.");
-                return nullptr;
-            }
-            std::shared_ptr<ASTNode> commaNode = parseComma();
-            if (commaNode) {
-                sentenceNode->addChild(commaNode);
-                acceptedTokens.push_back(tokens[currentPos - 1]);
-            }
+    while (pos < tokens.size() && tokens[pos].type != STOP) {
+        const TokenType type = tokens[pos].type;
+        if (type == COMMA) {
+            if (lastWasComma) return fail("Error: Consecutive commas found.");
+            add("Comma", false);
             lastWasComma = true;
             lastWasHyphen = false;
-        } else if (currentToken().type == HYPHEN) {
+        } else if (type == HYPHEN) {
             if (lastWasHyphen) {
-
-                // Flags for tracking comma till end of string
                 bool commaFound = false;
                 bool commaError = false;
-
-                // Checking for consecutive commas in rest of the string
-                size_t tempPos = currentPos;
-                while (tempPos < tokens.size() && tokens[tempPos].type != STOP) {
+                for (size_t tempPos = pos; tempPos < tokens.size() && tokens[tempPos].type != STOP; tempPos++) {
                     if (tokens[tempPos].type == COMMA) {
                         if (commaFound) {
                             commaError = true;
@@ -328,265 +4565,833 @@ private:
                         }
                         commaFound = true;
                     }
-                    tempPos++;
-                }
-
-                if (commaError) {
-                    errors.push_back("Error: Consecutive commas found.");
-                    return nullptr;
-                } else if (!commaFound) {
-                    errors.push_back("Error: Consecutive hyphens found.");
-                    return nullptr;
                 }
+                if (commaError) return fail("Error: Consecutive commas found.");
+                if (!commaFound) return fail("Error: Consecutive hyphens found.");
             }
+            add("Hyphen", false);
+            lastWasHyphen = true;
+            lastWasComma = false;
+        } else if (type == WORD || type == QUOTATION) {
+            add(type == WORD ? "Word" : "Quotation", true);
+            lastWasComma = false;
+            lastWasHyphen = false;
+        } else {
+            return fail("Unexpected token: " + tokens[pos].value);
+        }
+    }
+
+    if (pos >= tokens.size()) return fail("Expected STOP at the end");
+    add("Stop", false);
+    if (pos < tokens.size()) pos++;
+
+    if (tokens[pos - 1].type != STOP) return fail("Error: Extra tokens found after full stop.");
+    if (lexicalErrors) return fail("Error: Lexical errors found. Invalid tokens in the sentence.");
+
+    result.valid = true;
+    for (size_t i = 0; i < accepted.size(); ++i) {
+        if (accepted[i]->type != QUOTATION) {
+            result.accepted += accepted[i]->value;
+            if (i != accepted.size() - 1) result.accepted += ' ';
+        }
+    }
+    result.accepted += '\n';
+    result.ast = "Sentence \n" + children + "\n";
+    return result;
+}
+
+// Recovering form of the reference Parser: after an error it skips to the next Word or Stop,
+// and every repeated hyphen rescans the commas up to the Stop as the original Parser did
+std::vector<std::pair<ParseStatus, size_t>> referenceDiagnose(const std::vector<ReferenceToken>& tokens) {
+    std::vector<std::pair<ParseStatus, size_t>> errors;
+    const size_t count = tokens.size();
+    auto sync = [&](size_t pos) {
+        while (pos < count && tokens[pos].type != WORD && tokens[pos].type != STOP) pos++;
+        return pos;
+    };
+
+    size_t pos = 1;
+    if (count == 0 || tokens[0].type != STARTWORD) {
+        errors.push_back({ PARSE_EXPECTED_STARTWORD, 0 });
+        pos = sync(0);
+    }
 
-            std::shared_ptr<ASTNode> hyphenNode = parseHyphen();
-            if (hyphenNode) {
-                sentenceNode->addChild(hyphenNode);
-                acceptedTokens.push_back(tokens[currentPos - 1]);
+    bool lastWasComma = false;
+    bool lastWasHyphen = false;
+    while (pos < count && tokens[pos].type != STOP) {
+        const TokenType type = tokens[pos].type;
+        ParseStatus error = PARSE_OK;
+        if (type == COMMA) {
+            if (lastWasComma) error = PARSE_CONSECUTIVE_COMMAS;
+            lastWasComma = true;
+            lastWasHyphen = false;
+        } else if (type == HYPHEN) {
+            if (lastWasHyphen) {
+                size_t commas = 0;
+                for (size_t ahead = pos; ahead < count && tokens[ahead].type != STOP; ahead++) {
+                    if (tokens[ahead].type == COMMA) commas++;
+                }
+                if (commas >= 2) error = PARSE_CONSECUTIVE_COMMAS;
+                else if (commas == 0) error = PARSE_CONSECUTIVE_HYPHENS;
             }
             lastWasHyphen = true;
             lastWasComma = false;
-        } else if (currentToken().type == WORD) {
-            std::shared_ptr<ASTNode> wordNode = parseWord();
-            if (wordNode) {
-                sentenceNode->addChild(wordNode);
-                acceptedTokens.push_back(tokens[currentPos - 1]);
-            }
+        } else if (type == WORD || type == QUOTATION) {
             lastWasComma = false;
             lastWasHyphen = false;
-        } else if (currentToken().type == QUOTATION) {
-            std::shared_ptr<ASTNode> quotationNode = parseQuotation();
-            if (quotationNode) {
-                sentenceNode->addChild(quotationNode);
-                acceptedTokens.push_back(tokens[currentPos - 1]);
-            }
+        } else {
+            error = PARSE_UNEXPECTED_TOKEN;
+        }
+
+        if (error != PARSE_OK) {
+            errors.push_back({ error, pos });
+            pos = sync(pos + 1);
             lastWasComma = false;
             lastWasHyphen = false;
         } else {
-            errors.push_back("Unexpected token: " + currentToken().value);
-            return nullptr;
+            pos++;
         }
     }
 
-    // Check if we encountered the STOP token
-    if (currentPos < tokens.size() && currentToken().type == STOP) {
-        std::shared_ptr<ASTNode> stopNode = parseStop();
-        if (stopNode) {
-            sentenceNode->addChild(stopNode);
-            acceptedTokens.push_back(tokens[currentPos - 1]);
-            advanceToken();  // Move past the STOP token
+    if (pos >= count) errors.push_back({ PARSE_EXPECTED_STOP, count });
+    else if (pos + 1 < count && tokens[pos + 1].type != STOP) errors.push_back({ PARSE_EXTRA_TOKENS, pos + 1 });
+    return errors;
+}
 
-            // DEBUG: Confirm advancing after STOP
-            // std::cout << "Reached STOP token. Advancing token pointer.\n";
-        }
-    } else {
-        errors.push_back("Expected STOP at the end");
-        return nullptr;
+/**
+ * @struct ReferenceSentence
+ * @brief A sentence of the reference document split, with what the reference Parser prints for it.
+ */
+struct ReferenceSentence {
+    size_t offset;
+    size_t length;
+    std::string errors;             ///< Empty if the sentence is valid
+};
+
+// Splits a document after every Stop the reference Lexer emits; text after the last one that
+// holds a token is a sentence of its own
+std::vector<ReferenceSentence> referenceDocument(std::string_view document) {
+    std::vector<ReferenceSentence> sentences;
+    std::vector<ReferenceToken> validTokens;
+    bool lexicalErrors = false;
+    bool pending = false;
+    size_t begin = 0;
+    auto close = [&](size_t end) {
+        sentences.push_back({ begin, end - begin, referenceParse(validTokens, lexicalErrors).errors });
+        validTokens.clear();
+        lexicalErrors = false;
+        pending = false;
+        begin = end;
+    };
+
+    size_t pos = 0;
+    for (ReferenceToken token = referenceNextToken(document, pos); token.type != END; token = referenceNextToken(document, pos)) {
+        pending = true;
+        if (token.type == INVALID) lexicalErrors = true;
+        else validTokens.push_back(token);
+        if (token.type == STOP) close(pos);
     }
+    if (pending) close(document.size());
+    return sentences;
+}
 
-    // Check if any tokens remain after the STOP token
-    if (currentPos <= tokens.size() && (tokens[currentPos-1].type == WORD || tokens[currentPos-1].type == COMMA || tokens[currentPos-1].type == HYPHEN || tokens[currentPos-1].type == QUOTATION || tokens[currentPos-1].type == STARTWORD || tokens[currentPos-1].type == INVALID)){
-        // std::cout << "Extra tokens detected after STOP: " << currentToken().value << "\n";  // Debugging info
-        errors.push_back("Error: Extra tokens found after full stop.");
-        return nullptr;
+bool sameSentence(const SentenceResult& result, const ReferenceSentence& expected) {
+    return result.offset == expected.offset && result.length == expected.length &&
+           (expected.errors.empty() ? result.result.ok() : !result.result.ok() && result.message + "\n" == expected.errors);
+}
+
+bool sameToken(const Token& token, const ReferenceToken& expected) {
+    return token.type == expected.type && token.value == expected.value && token.offset == expected.offset;
+}
+
+bool sameToken(const Token& a, const Token& b) {
+    return a.type == b.type && a.value == b.value && a.offset == b.offset && a.symbol == b.symbol;
+}
+
+// Every scanning kernel must agree with the scalar one from every start position
+void fuzzScanKernels(std::string_view input) {
+    std::vector<const ScanKernels*> kernels;
+#ifdef LEXER_HAVE_SSE2
+    kernels.push_back(&sse2ScanKernels);
+#endif
+#ifdef LEXER_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(&avx2ScanKernels);
+#endif
+#ifdef LEXER_HAVE_NEON
+    kernels.push_back(&neonScanKernels);
+#endif
+
+    const char* data = input.data();
+    for (size_t pos = 0; pos < std::min<size_t>(input.size(), 4096); ++pos) {
+        const size_t end = std::min(input.size(), pos + 256);
+        for (const ScanKernels* kernel : kernels) {
+            fuzzExpect(kernel->skipSpaces(data, pos, end) == skipSpacesScalar(data, pos, end), "skipSpaces kernel", input);
+            fuzzExpect(kernel->skipLetters(data, pos, end) == skipLettersScalar(data, pos, end), "skipLetters kernel", input);
+            fuzzExpect(kernel->skipInvalid(data, pos, end) == skipInvalidScalar(data, pos, end), "skipInvalid kernel", input);
+        }
     }
+}
 
-    // Check for lexical errors
-    if (!lexicalErrors.empty()) {
-        errors.push_back("Error: Lexical errors found. Invalid tokens in the sentence.");
-        return nullptr;
+/**
+ * @brief Cost of compiling one input from scratch through the main entry points.
+ */
+struct FuzzCost {
+    uint64_t nanoseconds = UINT64_MAX;      ///< Fastest of a few runs
+    uint64_t allocations = 0;
+};
+
+FuzzCost fuzzMeasure(std::string_view text) {
+    FuzzCost cost;
+    for (int run = 0; run < 3; ++run) {
+        const uint64_t allocations = fuzzAllocations.load(std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+        {
+            CompilerSession session;
+            FlatAst ast;
+            std::vector<Diagnostic> diagnostics;
+            session.compile(text);
+            session.compileFlat(text, ast);
+            session.validate(text);
+            session.diagnose(text, diagnostics);
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        cost.nanoseconds = std::min<uint64_t>(cost.nanoseconds, static_cast<uint64_t>(elapsed.count()));
+        cost.allocations = fuzzAllocations.load(std::memory_order_relaxed) - allocations;
     }
+    return cost;
+}
+
+// Four copies of an input must cost about four times as much, not sixteen
+void fuzzScaling(std::string_view input) {
+    if (input.empty() || input.size() > FUZZ_MAX_SCALED_INPUT) return;
+
+    std::string repeated;
+    for (int copy = 0; copy < 4; ++copy) repeated.append(input.data(), input.size());
+
+    const FuzzCost single = fuzzMeasure(input);
+    const FuzzCost scaled = fuzzMeasure(repeated);
+    fuzzExpect(scaled.allocations <= 4 * single.allocations + FUZZ_ALLOCATION_SLACK, "allocations grow super-linearly", input);
+    fuzzExpect(scaled.nanoseconds <= 8 * single.nanoseconds + FUZZ_TIME_SLACK_NS, "time grows super-linearly", input);
+}
+
+/**
+ * @struct FuzzRegression
+ * @brief An input whose diagnose() output was once wrong, with the diagnostics it must give.
+ */
+struct FuzzRegression {
+    const char* input;
+    std::vector<ParseStatus> statuses;      ///< Every expected diagnostic, in order
+};
+
+// Comma errors before a later hyphen pair used to drop that pair's error
+const FuzzRegression fuzzRegressions[] = {
+    { "Abc - - , xyz , , yyy - - zzz .",
+      { PARSE_CONSECUTIVE_COMMAS, PARSE_CONSECUTIVE_COMMAS, PARSE_CONSECUTIVE_HYPHENS } },
+    { "Abc - - , xyz , , yyy , qqq - - zzz .",
+      { PARSE_CONSECUTIVE_COMMAS, PARSE_CONSECUTIVE_COMMAS, PARSE_CONSECUTIVE_HYPHENS } },
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
 
-    return sentenceNode;
+// Checks the known regressions, on their own and through every check of the target, before
+// any fuzzing starts
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    CompilerSession session;
+    std::vector<Diagnostic> diagnostics;
+    for (const FuzzRegression& regression : fuzzRegressions) {
+        session.diagnose(regression.input, diagnostics);
+        fuzzExpect(std::equal(diagnostics.begin(), diagnostics.end(), regression.statuses.begin(), regression.statuses.end(),
+                              [](const Diagnostic& d, ParseStatus status) { return d.status == status; }),
+                   "diagnose regression", regression.input);
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(regression.input), std::strlen(regression.input));
+    }
+    return 0;
 }
 
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size > FUZZ_MAX_INPUT) return 0;
+    const std::string_view input(reinterpret_cast<const char*>(data), size);
 
-    /**
-     * @brief Parses a Startword token.
-     * @return std::shared_ptr<ASTNode> The node representing the Startword, or nullptr if parsing fails.
-     */
-    std::shared_ptr<ASTNode> parseStartword() {
-        if (currentToken().type == STARTWORD) {
-            std::shared_ptr<ASTNode> node = std::make_shared<ASTNode>("Startword: " + currentToken().value);
-            advanceToken();  // Move to the next token
-            return node;
-        } else {
-            errors.push_back("Expected Startword, got: " + currentToken().value);
-            return nullptr;
+    // Reference results
+    std::vector<ReferenceToken> allTokens;
+    std::vector<ReferenceToken> validTokens;
+    std::string lexicalErrors;
+    size_t referencePos = 0;
+    for (ReferenceToken token = referenceNextToken(input, referencePos); token.type != END; token = referenceNextToken(input, referencePos)) {
+        if (token.type == INVALID) lexicalErrors += "Invalid token: " + token.value + "\n";
+        else validTokens.push_back(token);
+        allTokens.push_back(std::move(token));
+    }
+    const ReferenceResult expected = referenceParse(validTokens, !lexicalErrors.empty());
+
+    fuzzScanKernels(input);
+
+    // Lexer
+    CompilationContext context;
+    Lexer lexer(input, context);
+    std::vector<Token> tokens;
+    lexer.tokenizeAll(tokens);
+    fuzzExpect(tokens.size() == validTokens.size() && std::equal(tokens.begin(), tokens.end(), validTokens.begin(),
+               [](const Token& a, const ReferenceToken& b) { return sameToken(a, b); }), "tokenizeAll tokens", input);
+    for (const Token& token : tokens) {
+        fuzzExpect(token.symbol == NO_SYMBOL || lexer.symbols().name(token.symbol) == token.value, "symbol names", input);
+    }
+    std::string lexicalText;
+    {
+        StringSink out(lexicalText);
+        for (const Diagnostic& error : context.lexicalErrors) {
+            writeDiagnostic(out, error);
+            out << '\n';
         }
     }
+    fuzzExpect(lexicalText == lexicalErrors, "lexical errors", input);
 
-    /**
-     * @brief Parses a Word token.
-     * @return std::shared_ptr<ASTNode> The node representing the Word, or nullptr if parsing fails.
-     */
-    std::shared_ptr<ASTNode> parseWord() {
-        if (currentToken().type == WORD) {
-            std::shared_ptr<ASTNode> node = std::make_shared<ASTNode>("Word: " + currentToken().value);
-            advanceToken();  // Move to the next token
-            return node;
-        } else {
-            errors.push_back("Expected Word, got: " + currentToken().value);
-            return nullptr;
+    // Packed tokens
+    CompilationContext packedContext;
+    PackedTokenStream packed;
+    {
+        Lexer packedLexer(input, packedContext);
+        std::vector<Token> unpacked;
+        std::string error;
+        fuzzExpect(packedLexer.tokenizePacked(packed, error), "tokenizePacked", input);
+        packed.unpack(input, unpacked);
+        fuzzExpect(unpacked.size() == tokens.size() && std::equal(unpacked.begin(), unpacked.end(), tokens.begin(),
+                   [](const Token& a, const Token& b) { return sameToken(a, b); }), "packed tokens", input);
+    }
+
+    // Chunked lexing, with chunk sizes drawn from the input itself
+    {
+        CompilationContext chunkContext;
+        ChunkedLexer chunked(chunkContext);
+        size_t next = 0;
+        bool same = true;
+        auto onToken = [&](const Token& token) {
+            same = same && next < allTokens.size() && sameToken(token, allTokens[next]);
+            next++;
+        };
+        uint64_t sizes = hashBytes(input);
+        for (size_t offset = 0; offset < input.size(); ) {
+            const size_t length = std::min<size_t>(input.size() - offset, 1 + (sizes & 63));
+            sizes = (sizes >> 6) | (sizes << 58);
+            chunked.feed(input.substr(offset, length), onToken);
+            offset += length;
         }
+        chunked.finish(onToken);
+        fuzzExpect(same && next == allTokens.size(), "chunked tokens", input);
     }
 
-    /**
-     * @brief Parses a Comma token.
-     * @return std::shared_ptr<ASTNode> The node representing the Comma, or nullptr if parsing fails.
-     */
-    std::shared_ptr<ASTNode> parseComma() {
-        if (currentToken().type == COMMA) {
-            std::shared_ptr<ASTNode> node = std::make_shared<ASTNode>("Comma");
-            advanceToken();  // Move to the next token
-            return node;
-        } else {
-            errors.push_back("Expected Comma, got: " + currentToken().value);
-            return nullptr;
+    // Parser: tree, compact tree and validation only
+    Parser parser(tokens, context);
+    const ASTNode* root = parser.parse();
+    std::string errors, accepted, ast;
+    {
+        StringSink errorsOut(errors), acceptedOut(accepted), astOut(ast);
+        parser.printErrors(errorsOut);
+        if (root) {
+            parser.printAcceptedString(acceptedOut);
+            printASTLevelOrder(root, tokens, astOut);
         }
     }
-    
-     /**
-     * @brief Parses a Hyphen token.
-     * @return std::shared_ptr<ASTNode> The node representing the Hyphen, or nullptr if parsing fails.
-     */
-    std::shared_ptr<ASTNode> parseHyphen() {
-        if (currentToken().type == HYPHEN) {
-            std::shared_ptr<ASTNode> node = std::make_shared<ASTNode>("Hyphen");
-            advanceToken();  // Move to the next token
-            return node;
-        } else {
-            errors.push_back("Expected Hyphen, got: " + currentToken().value);
-            return nullptr;
+    fuzzExpect((root != nullptr) == expected.valid, "parse validity", input);
+    fuzzExpect(errors == expected.errors && accepted == expected.accepted && ast == expected.ast, "parse output", input);
+    const ValidationResult parsed = parser.result();
+    const size_t parseErrorCount = context.parseErrors.size();
+
+    FlatAst flat;
+    std::string flatErrors, flatAst;
+    const bool flatValid = parser.parseFlat(flat);
+    {
+        StringSink errorsOut(flatErrors), astOut(flatAst);
+        parser.printErrors(errorsOut);
+        printASTLevelOrder(flat, tokens, astOut);
+    }
+    fuzzExpect(flatValid == expected.valid && flatErrors == expected.errors && flatAst == expected.ast, "parseFlat output", input);
+
+    const ValidationResult validated = parser.validate();
+    fuzzExpect(validated.ok() == expected.valid && validated.status == parsed.status, "validate status", input);
+    fuzzExpect(expected.valid || parser.describe(validated) + "\n" == expected.errors, "validate message", input);
+
+    // The same Parser reading the packed tokens in place
+    {
+        PackedParser packedParser(packed, packedContext);
+        const ASTNode* packedRoot = packedParser.parse();
+        std::string packedErrors, packedAccepted, packedAst;
+        {
+            StringSink errorsOut(packedErrors), acceptedOut(packedAccepted), astOut(packedAst);
+            packedParser.printErrors(errorsOut);
+            if (packedRoot) {
+                packedParser.printAcceptedString(acceptedOut);
+                printASTLevelOrder(packedRoot, tokens, astOut);
+            }
         }
+        fuzzExpect(packedErrors == expected.errors && packedAccepted == expected.accepted && packedAst == expected.ast, "packed parse output", input);
+        const ValidationResult packedValidated = packedParser.validate();
+        fuzzExpect(packedValidated.status == validated.status && packedValidated.tokenIndex == validated.tokenIndex, "packed validate", input);
     }
 
-    /**
-     * @brief Parses a Quotation token.
-     * @return std::shared_ptr<ASTNode> The node representing the Quotation, or nullptr if parsing fails.
-     */
-    std::shared_ptr<ASTNode> parseQuotation() {
-        if (currentToken().type == QUOTATION) {
-            std::shared_ptr<ASTNode> node = std::make_shared<ASTNode>("Quotation: " + currentToken().value);
-            advanceToken();  // Move to the next token
-            return node;
-        } else {
-            errors.push_back("Expected Quotation, got: " + currentToken().value);
-            return nullptr;
+    // Session: streaming validation and recovering diagnostics
+    CompilerSession session;
+    const ValidationResult streamed = session.validate(input);
+    fuzzExpect(streamed.status == parsed.status && streamed.tokenIndex == validated.tokenIndex, "streaming status", input);
+    fuzzExpect(expected.valid || session.describe(streamed) + "\n" == expected.errors, "streaming message", input);
+
+    // Every diagnostic: the invalid tokens and the recovering reference Parser's errors, merged
+    // by offset with the lexical one first at equal offsets
+    std::vector<Diagnostic> diagnostics;
+    session.diagnose(input, diagnostics);
+    {
+        std::vector<Diagnostic> expectedDiagnostics;
+        for (const ReferenceToken& token : allTokens) {
+            if (token.type == INVALID) expectedDiagnostics.push_back({ PARSE_INVALID_TOKEN, NO_TOKEN, token.offset, token.value });
+        }
+        const size_t lexical = expectedDiagnostics.size();
+        size_t end = 0;
+        if (!validTokens.empty()) {
+            const ReferenceToken& last = validTokens.back();
+            end = last.offset + last.value.size() + (last.type == QUOTATION ? 1 : 0);
+        }
+        for (const auto& error : referenceDiagnose(validTokens)) {
+            if (error.second < validTokens.size()) {
+                const ReferenceToken& token = validTokens[error.second];
+                expectedDiagnostics.push_back({ error.first, static_cast<uint32_t>(error.second), token.offset, token.value });
+            } else {
+                expectedDiagnostics.push_back({ error.first, static_cast<uint32_t>(validTokens.size()), end, std::string_view() });
+            }
         }
+        std::inplace_merge(expectedDiagnostics.begin(), expectedDiagnostics.begin() + lexical, expectedDiagnostics.end(),
+                           [](const Diagnostic& a, const Diagnostic& b) { return a.offset < b.offset; });
+        fuzzExpect(std::equal(diagnostics.begin(), diagnostics.end(), expectedDiagnostics.begin(), expectedDiagnostics.end(),
+                              [](const Diagnostic& a, const Diagnostic& b) {
+                                  return a.status == b.status && a.tokenIndex == b.tokenIndex && a.offset == b.offset && a.text == b.text;
+                              }), "diagnose list", input);
+        fuzzExpect(diagnostics.empty() == expected.valid, "diagnose on valid input", input);
+        fuzzExpect(expected.valid || parsed.status == PARSE_LEXICAL_ERRORS ||
+                   describeDiagnostic(*std::find_if(diagnostics.begin(), diagnostics.end(),
+                                                    [](const Diagnostic& d) { return d.status != PARSE_INVALID_TOKEN; })) + "\n" == expected.errors,
+                   "diagnose first error", input);
     }
 
-    /**
-     * @brief Parses a Stop token.
-     * @return std::shared_ptr<ASTNode> The node representing the Stop, or nullptr if parsing fails.
-     */
-    std::shared_ptr<ASTNode> parseStop() {
-        if (currentToken().type == STOP) {
-            std::shared_ptr<ASTNode> node = std::make_shared<ASTNode>("Stop");
-            advanceToken();  // Move to the next token
-            return node;
-        } else {
-            errors.push_back("Expected Stop, got: " + currentToken().value);
-            return nullptr;
+    // Documents: the input split into sentences, validated in parallel and edited in place
+    {
+        static ThreadPool pool(2);
+        const std::vector<ReferenceSentence> sentences = referenceDocument(input);
+        const std::vector<SentenceResult> results = validateDocument(input, pool);
+        fuzzExpect(std::equal(results.begin(), results.end(), sentences.begin(), sentences.end(), sameSentence), "validateDocument", input);
+
+        auto sameDocument = [](const IncrementalDocument& document, std::string_view text) {
+            const std::vector<ReferenceSentence> expectedSentences = referenceDocument(text);
+            if (document.text() != text || document.sentenceCount() != expectedSentences.size()) return false;
+            for (size_t i = 0; i < expectedSentences.size(); ++i) {
+                if (!sameSentence(document.sentence(i), expectedSentences[i])) return false;
+            }
+            return true;
+        };
+
+        // Start from the first half and apply edits drawn from the input
+        std::string text(input.substr(0, input.size() / 2));
+        IncrementalDocument document(text);
+        fuzzExpect(sameDocument(document, text), "IncrementalDocument", input);
+        uint64_t edits = hashBytes(input);
+        for (int edit = 0; edit < 4; ++edit) {
+            const size_t offset = edits % (text.size() + 1);
+            const size_t removed = std::min<size_t>((edits >> 16) % 8, text.size() - offset);
+            const size_t from = (edits >> 24) % (input.size() + 1);
+            const std::string_view inserted = input.substr(from, (edits >> 40) % 16);
+            edits = edits * 6364136223846793005ull + 1442695040888963407ull;
+            text.replace(offset, removed, inserted.data(), inserted.size());
+            document.applyEdit(offset, removed, inserted);
+            fuzzExpect(sameDocument(document, text), "IncrementalDocument edit", input);
+        }
+    }
+
+    // Batch: every line of the input as a separate input
+    {
+        static ThreadPool pool(2);
+        std::vector<std::string_view> lines;
+        for (std::string_view rest = input; !rest.empty(); ) {
+            const size_t end = std::min(rest.find('\n'), rest.size());
+            lines.push_back(rest.substr(0, end));
+            rest.remove_prefix(std::min(end + 1, rest.size()));
+        }
+        const std::vector<ValidationResult> results = validateBatch(lines, pool);
+        for (size_t i = 0; i < lines.size(); ++i) {
+            std::vector<ReferenceToken> lineTokens;
+            bool lineLexicalErrors = false;
+            size_t pos = 0;
+            for (ReferenceToken token = referenceNextToken(lines[i], pos); token.type != END; token = referenceNextToken(lines[i], pos)) {
+                if (token.type == INVALID) lineLexicalErrors = true;
+                else lineTokens.push_back(std::move(token));
+            }
+            const ReferenceResult lineExpected = referenceParse(lineTokens, lineLexicalErrors);
+            const std::string_view text = results[i].tokenIndex < lineTokens.size() ? std::string_view(lineTokens[results[i].tokenIndex].value) : std::string_view();
+            fuzzExpect(results[i].ok() == lineExpected.valid &&
+                       (lineExpected.valid || describeParseError(results[i].status, text) + "\n" == lineExpected.errors), "validateBatch", input);
         }
     }
-};
 
+    // Cache: a repeated input is a hit with the same outcome
+    {
+        ParseCache cache(4, true);
+        cache.compile(input);
+        const ParseCache::Entry& entry = cache.compile(input);
+        fuzzExpect(cache.hits() == 1 && entry.result.status == parsed.status && entry.parseErrors.size() == parseErrorCount,
+                   "cache result", input);
+    }
 
-// Helper function to print the AST structure in level-order format
-void printASTLevelOrder(const std::shared_ptr<ASTNode>& root) {
-    if (!root) return;
+    // Binary format: round trip, and arbitrary bytes are rejected without crashing
+    {
+        std::string blob;
+        CompiledImage image;
+        writeBinary(tokens, lexer.symbols(), flatValid ? &flat : nullptr, blob);
+        fuzzExpect(readBinary(blob, image), "binary round trip", input);
+        fuzzExpect(image.tokens.size() == tokens.size() && image.ast.size() == flat.size(), "binary contents", input);
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            fuzzExpect(image.tokens[i].type == tokens[i].type && image.tokens[i].value == tokens[i].value &&
+                       image.tokens[i].offset == tokens[i].offset, "binary tokens", input);
+        }
+        readBinary(input, image);
+    }
 
-    std::queue<std::shared_ptr<ASTNode>> nodeQueue;
-    nodeQueue.push(root);
+    fuzzScaling(input);
+    return 0;
+}
+
+#ifdef COMPILER_FUZZER_STANDALONE
+int main(int argc, char* argv[]) {
+    // Replays the given files through the fuzz target
+    LLVMFuzzerInitialize(&argc, &argv);
+    for (int i = 1; i < argc; ++i) {
+        MappedFile file;
+        std::string error;
+        if (!file.open(argv[i], error)) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(file.view().data()), file.view().size());
+    }
+    std::cerr << "ran " << (argc - 1) << " inputs\n";
+    return 0;
+}
+#endif
 
-    while (!nodeQueue.empty()) {
-        size_t levelSize = nodeQueue.size();  // Number of nodes at current level
+#else
 
-        // Process all nodes at the current level
-        for (size_t i = 0; i < levelSize; ++i) {
-            std::shared_ptr<ASTNode> currentNode = nodeQueue.front();
-            nodeQueue.pop();
+// Command-line driver
+/**
+ * @brief What the driver prints for each input.
+ */
+enum OutputMode {
+    OUTPUT_REPORT,          ///< Tokens, errors, accepted string and AST (the default)
+    OUTPUT_QUIET,           ///< Nothing; only the exit status tells whether every input is valid
+    OUTPUT_VALIDITY,        ///< "valid" or "invalid: <message>", one line per input
+    OUTPUT_TOKENS,          ///< One "TYPE<TAB>value" line per token, then an empty line
+    OUTPUT_AST,             ///< The AST, or "invalid: <message>"
+    OUTPUT_DIAGNOSTICS,     ///< Every error as "line:column: <message>", then an empty line
+    OUTPUT_BINARY           ///< writeBinary() images, each preceded by its length as a varint
+};
+
+/**
+ * @struct CommandLine
+ * @brief Options of the driver.
+ */
+struct CommandLine {
+    OutputMode mode = OUTPUT_REPORT;
+    bool batch = false;                 ///< Every line of the input is a separate input
+    bool stats = false;                 ///< Print throughput on stderr
+    bool help = false;                  ///< Print the usage and exit
+    size_t threads = 1;                 ///< Threads for batches and multiple files (0: one per hardware thread)
+    std::vector<const char*> files;     ///< Input files; "-" is stdin
+};
 
-            // Print the value of the current node
-            std::cout << currentNode->value << " ";
+const char USAGE[] =
+    "usage: compiler [options] [file...]\n"
+    "Checks each file (\"-\" for stdin) against the sentence grammar. Without files the built-in\n"
+    "example is used.\n"
+    "  -b, --batch      treat every line as a separate input\n"
+    "  -j N             use N threads for batches and multiple files (0: all cores)\n"
+    "  -q, --quiet      print nothing; exit status 1 if any input is invalid\n"
+    "  --validity       print \"valid\" or \"invalid: <message>\" per input\n"
+    "  --tokens         print the tokens of each input\n"
+    "  --ast            print the AST of each valid input\n"
+    "  --diagnostics    print every error of each input with its line and column\n"
+    "  --binary         write the compiled binary image of each input\n"
+    "  --stats          print throughput on stderr\n"
+    "  -h, --help       show this help\n";
 
-            // Enqueue all children of the current node
-            for (const auto& child : currentNode->children) {
-                nodeQueue.push(child);
+/**
+ * @brief Parses the arguments.
+ * @param error Receives the reason if they are not valid.
+ * @return bool False on an unknown option or a bad -j value.
+ */
+bool parseCommandLine(int argc, char* argv[], CommandLine& options, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "-h" || arg == "--help") options.help = true;
+        else if (arg == "-b" || arg == "--batch") options.batch = true;
+        else if (arg == "-q" || arg == "--quiet") options.mode = OUTPUT_QUIET;
+        else if (arg == "--validity") options.mode = OUTPUT_VALIDITY;
+        else if (arg == "--tokens") options.mode = OUTPUT_TOKENS;
+        else if (arg == "--ast") options.mode = OUTPUT_AST;
+        else if (arg == "--diagnostics") options.mode = OUTPUT_DIAGNOSTICS;
+        else if (arg == "--binary") options.mode = OUTPUT_BINARY;
+        else if (arg == "--stats") options.stats = true;
+        else if (arg == "-j" || (arg.size() > 2 && arg.substr(0, 2) == "-j")) {
+            std::string_view count = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? std::string_view(argv[++i]) : std::string_view());
+            if (count.empty() || count.size() > 4 || count.find_first_not_of("0123456789") != std::string_view::npos) {
+                error = "invalid thread count for -j";
+                return false;
             }
+            options.threads = 0;
+            for (char digit : count) options.threads = options.threads * 10 + static_cast<size_t>(digit - '0');
+        }
+        else if (arg == "-" || arg.empty() || arg[0] != '-') options.files.push_back(argv[i]);
+        else {
+            error = "unknown option: ";
+            error.append(arg.data(), arg.size());
+            return false;
         }
-
-        std::cout << std::endl;  // Print a newline after each level
     }
+    return true;
+}
+
+/**
+ * @brief Reads all of stdin.
+ * @return bool False if reading failed.
+ */
+bool readStandardInput(std::string& text) {
+    char chunk[65536];
+    size_t length;
+    while ((length = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0) text.append(chunk, length);
+    return !std::ferror(stdin);
 }
 
+/**
+ * @brief Prints the full report of one input, in the format of the original driver.
+ * @return bool True if the input is valid.
+ */
+bool writeReport(std::string_view source, CompilerSession& session, OutputSink& out) {
+    const bool valid = session.compile(source);
+
+    out << "Symbol Table: \n";
+    for (const auto& tok : session.tokens()) {
+        // Use the helper function to convert token type to string
+        out << "Token Type: " << tokenTypeToString(tok.type) << " ,Token Value: " << tok.value << '\n';
+    }
 
+    // Print errors from lexical phase
+    if (!session.context().lexicalErrors.empty()) {
+        out << "\nLexical Errors: \n";
+        for (const Diagnostic& err : session.context().lexicalErrors) {
+            writeDiagnostic(out, err);
+            out << '\n';
+        }
+    }
 
-// Helper function to convert TokenType enum to a string
-std::string tokenTypeToString(TokenType type) {
-    switch (type) {
-        case STARTWORD: return "STARTWORD";
-        case WORD: return "WORD";
-        case COMMA: return "COMMA";
-        case HYPHEN: return "HYPHEN";
-        case STOP: return "STOP";
-        case QUOTATION: return "QUOTATION";
-        case INVALID: return "INVALID";
-        case END: return "END";
-        default: return "UNKNOWN";
+    // Parsing phase
+    const Parser& parser = session.getParser();
+    if (!valid) {
+        out << "\nThe string is invalid. \n";
+        out << "\nParsing Errors: \n";
+        parser.printErrors(out);
+    } else {
+        out << "\nThe string is valid. \n";
+        out << "\nAccepted String: ";
+        parser.printAcceptedString(out);
+        out << "\nAST Structure: \n";
+        printASTLevelOrder(session.ast(), session.tokens(), out);    // Print the AST
     }
+    return valid;
 }
 
+/**
+ * @brief Per-thread state of the driver.
+ */
+struct DriverWorker {
+    CompilerSession session;
+    CompilationContext context;                         ///< Errors of the token listing
+    Lexer lexer{ std::string_view(), context };         ///< Lists tokens, invalid ones included
+    FlatAst ast;
+    std::vector<Diagnostic> diagnostics;
+    std::string blob;
+};
 
+/**
+ * @brief Processes one input in the selected output mode.
+ * @return bool True if the input is valid.
+ */
+bool processInput(std::string_view source, OutputMode mode, DriverWorker& worker, OutputSink& out) {
+    CompilerSession& session = worker.session;
+    switch (mode) {
+        case OUTPUT_REPORT:
+            return writeReport(source, session, out);
 
-int main() {
-    std::string input = "Hello, world-wide communication technologies.";
+        case OUTPUT_QUIET:
+            return session.validate(source).ok();
 
-    Lexer lexer(input);
-    std::vector<Token> tokens;
+        case OUTPUT_VALIDITY: {
+            const ValidationResult result = session.validate(source);
+            if (result.ok()) out << "valid\n";
+            else out << "invalid: " << session.describe(result) << '\n';
+            return result.ok();
+        }
 
-    Token token;
-    while ((token = lexer.nextToken()).type != END) {
-        if (token.type == INVALID) {
-            lexicalErrors.push_back("Invalid token: " + token.value);
+        case OUTPUT_TOKENS: {
+            Lexer& lexer = worker.lexer;
+            lexer.reset(source);
+            for (Token token = lexer.nextToken(); token.type != END; token = lexer.nextToken()) {
+                out << tokenTypeToString(token.type) << '\t' << token.value << '\n';
+            }
+            out << '\n';
+            return session.validate(source).ok();
+        }
 
-        } else {
-            tokens.push_back(token);
+        case OUTPUT_AST: {
+            const bool valid = session.compile(source);
+            if (valid) {
+                printASTLevelOrder(session.ast(), session.tokens(), out);
+            } else {
+                out << "invalid: ";
+                session.getParser().printErrors(out);
+            }
+            return valid;
+        }
+
+        case OUTPUT_DIAGNOSTICS: {
+            const LineIndex lines(source);
+            session.diagnose(source, worker.diagnostics);
+            for (const Diagnostic& diagnostic : worker.diagnostics) {
+                writeDiagnostic(out, diagnostic, lines);
+                out << '\n';
+            }
+            out << '\n';
+            return worker.diagnostics.empty();
+        }
+
+        case OUTPUT_BINARY: {
+            const bool valid = session.compileFlat(source, worker.ast).ok();
+            worker.blob.clear();
+            writeBinary(session.tokens(), session.symbols(), valid ? &worker.ast : nullptr, worker.blob);
+            std::string length;
+            writeVarint(length, worker.blob.size());
+            out << length << worker.blob;
+            return valid;
         }
     }
+    return false;
+}
 
-    std::cout << "Symbol Table: \n";
-    for (const auto& tok : tokens) {
-        // Use the helper function to convert token type to string
-        std::cout << "Token Type: " << tokenTypeToString(tok.type) << " ,Token Value: " << tok.value << '\n';
+/**
+ * @brief Processes inputs in order, on several threads if asked to.
+ *
+ * With more than one thread the inputs are handled in blocks: each block is processed in
+ * parallel into per-input buffers, which are then written out in input order.
+ *
+ * @return size_t The number of valid inputs.
+ */
+size_t processInputs(const std::vector<std::string_view>& inputs, const CommandLine& options, OutputSink& out) {
+    ThreadPool pool(options.threads);
+    std::vector<DriverWorker> workers(pool.size());
+    size_t validCount = 0;
+
+    if (pool.size() == 1) {
+        for (std::string_view input : inputs) validCount += processInput(input, options.mode, workers[0], out);
+        return validCount;
     }
 
-    // Print errors from lexical phase
-    if (!lexicalErrors.empty()) {
-        std::cout << "\nLexical Errors: \n";
-        for (const auto& err : lexicalErrors) {
-            std::cout << err << '\n';
+    constexpr size_t BLOCK_INPUTS = 4096;
+    std::vector<std::string> outputs(std::min(inputs.size(), BLOCK_INPUTS));
+    std::vector<char> valid(outputs.size());
+    for (size_t first = 0; first < inputs.size(); first += BLOCK_INPUTS) {
+        const size_t count = std::min(BLOCK_INPUTS, inputs.size() - first);
+        pool.parallelFor(count, [&](size_t worker, size_t index) {
+            outputs[index].clear();
+            StringSink sink(outputs[index]);
+            valid[index] = processInput(inputs[first + index], options.mode, workers[worker], sink);
+        });
+        for (size_t index = 0; index < count; ++index) {
+            out << outputs[index];
+            validCount += valid[index];
         }
     }
+    return validCount;
+}
+
+int main(int argc, char* argv[]) {
+    std::ios::sync_with_stdio(false);       // Output goes through OutputSink; keep iostreams out of the way
+    std::string input = "Hello, world-wide communication technologies.";
+
+    CommandLine options;
+    std::string error;
+    if (!parseCommandLine(argc, argv, options, error)) {
+        std::cerr << error << '\n' << USAGE;
+        return 2;
+    }
+    if (options.help) {
+        std::cout << USAGE;
+        return 0;
+    }
 
+    // Files stay mapped until the end; stdin is read into a buffer
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::string standardInput;
+    std::vector<std::string_view> sources;
+    for (const char* path : options.files) {
+        if (std::string_view(path) == "-") {
+            if (!readStandardInput(standardInput)) {
+                std::cerr << "error reading stdin\n";
+                return 2;
+            }
+            sources.push_back(standardInput);
+            continue;
+        }
+        files.push_back(std::make_unique<MappedFile>());
+        if (!files.back()->open(path, error)) {
+            std::cerr << error << '\n';
+            return 2;
+        }
+        sources.push_back(files.back()->view());
+    }
+    if (options.files.empty()) sources.push_back(input);
 
-    // Parsing phase
-    Parser parser(tokens);
-    auto ast = parser.parse();
+    // Batches split on newlines; a final newline does not start another input
+    std::vector<std::string_view> inputs;
+    size_t bytes = 0;
+    for (std::string_view source : sources) {
+        bytes += source.size();
+        if (!options.batch) {
+            inputs.push_back(source);
+            continue;
+        }
+        while (!source.empty()) {
+            const size_t end = std::min(source.find('\n'), source.size());
+            std::string_view line = source.substr(0, end);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            inputs.push_back(line);
+            source.remove_prefix(std::min(end + 1, source.size()));
+        }
+    }
 
-    if (parser.hasErrors()) {
-        std::cout<< "\nThe string is invalid. \n";
-        std::cout << "\nParsing Errors: \n";
-        parser.printErrors();
-    } else {
-        std::cout<< "\nThe string is valid. \n";
-        std::cout << "\nAccepted String: ";
-        parser.printAcceptedString();
-        std::cout << "\nAST Structure: \n";
-        printASTLevelOrder(ast);            // Print the AST
+    FdSink& out = standardOutput();
+    const auto start = std::chrono::steady_clock::now();
+    const size_t validCount = processInputs(inputs, options, out);
+    out.flush();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (out.failed()) {
+        std::cerr << "error writing stdout\n";
+        return 2;
     }
 
-    return 0;
+    if (options.stats) {
+        const double seconds = std::max(elapsed.count(), 1e-9);
+        std::cerr << "inputs: " << inputs.size() << " (" << validCount << " valid), bytes: " << bytes
+                  << ", time: " << seconds * 1e3 << " ms, " << bytes / seconds / 1e6 << " MB/s, "
+                  << static_cast<uint64_t>(inputs.size() / seconds) << " inputs/s\n";
+#ifdef COMPILER_INSTRUMENT
+        // Instrumented builds add their counters
+        FdSink stats(2);
+        writeInstrumentJson(stats);
+#endif
+    }
+    return validCount == inputs.size() ? 0 : 1;
 }
+#endif